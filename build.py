@@ -10,6 +10,7 @@ PIOENV              = env.get("PIOENV")
 
 SRC_DIR             = "src"
 FREERUN_TIMER_DIR   = join(SRC_DIR, "freerun_timer")
+LATENCY_STAT_DIR    = join(SRC_DIR, "latency_stat")
 SHELL_DIR           = join(SRC_DIR, "shell")
 SOUND_DIR           = join(SRC_DIR, "sound")
 SOUND_APP_DIR       = join(SOUND_DIR, "app")
@@ -28,11 +29,13 @@ env.Append(
     CPPPATH = [
         join(PROJ_DIR, SRC_DIR),
         join(PROJ_DIR, FREERUN_TIMER_DIR),
+        join(PROJ_DIR, LATENCY_STAT_DIR),
         join(PROJ_DIR, SHELL_DIR),
         join(PROJ_DIR, SOUND_DIR),
         join(PROJ_DIR, SOUND_APP_DIR),
         join(PROJ_DIR, SOUND_APP_DIR, "single_ymf825"),
         join(PROJ_DIR, SOUND_APP_DIR, "single_ymz294"),
+        join(PROJ_DIR, SOUND_APP_DIR, "common"),
         join(PROJ_DIR, SOUND_MIDI_DIR),
         join(PROJ_DIR, SOUND_COMPONENT_DIR),
         join(PROJ_DIR, SOUND_COMPONENT_DIR, "ymf825"),
@@ -78,8 +81,7 @@ env.Replace(
     ],
 
     LIBS=[
-        "c_nano",
-        "m" # libm
+        "c_nano"
     ],
 
     LDSCRIPT_PATH = [
@@ -41,6 +41,12 @@ OF SUCH DAMAGE.
 extern uint32_t usbfs_prescaler;
 
 extern void usb_timer_irq     (void);
+#ifdef USE_YMF825_SPI_DMA
+extern void ymf825_spi_dma_irq(void);
+#endif
+#ifdef USE_YMZ294_BUS_QUEUE
+extern void ymz294_bus_timer_irq(void);
+#endif
 
 /*!
     \brief      this function handles USBD interrupt
@@ -101,3 +107,29 @@ void TIMER6_IRQHandler(void)
 {
     usb_cdc_send_service_irq();
 }
+
+#ifdef USE_YMZ294_BUS_QUEUE
+/*!
+    \brief      this function handles TIMER3 (YMZ294 bus writer) interrupt request.
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+void TIMER3_IRQHandler(void)
+{
+    ymz294_bus_timer_irq();
+}
+#endif
+
+#ifdef USE_YMF825_SPI_DMA
+/*!
+    \brief      this function handles DMA0 channel4 (SPI1_TX) interrupt request.
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+void DMA0_Channel4_IRQHandler(void)
+{
+    ymf825_spi_dma_irq();
+}
+#endif
@@ -0,0 +1,689 @@
+/*
+  MIT License
+
+  Copyright (c) 2020 nyannkov
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+// benchmark of the host build.
+// replays MIDI corpora through the usb midi event queue (usb_midi_receive_irq() and usb_midi_task())
+// and reports the throughput and the SPI traffic.
+//
+// usage: nano_midi_bench [-d mode4|mbox|poly] [-r repeat] [-t trace_file] [smf_file ...]
+//        without smf_file, a synthetic corpus is used.
+//        nano_midi_bench -p [-r repeat]
+//        compares the integer pitch bend with the former pow() based code.
+//        nano_midi_bench -n [-r repeat]
+//        cost of one note on/off pair in each engine, called directly (the SPI stub included).
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <math.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_HAS_TSC
+#endif
+#include "host_hal.h"
+#include "gd32vf103_gpio.h"
+#include "freerun_timer.h"
+#include "usb_midi_app.h"
+#ifdef USE_LATENCY_STAT
+#include "latency_stat.h"
+#endif
+#include "ymf825.h"
+#include "pitch_bend.h"
+#include "mode4_ymf825.h"
+#include "music_box_ymf825.h"
+#include "poly_ymf825.h"
+#include "single_ymz294.h"
+
+#define BENCH_USB_PACKET_SIZE	64	// bytes of one usb packet
+#define BENCH_DEFAULT_REPEAT	20
+
+typedef struct
+{
+	uint32_t tick;
+	uint32_t seq;
+	uint8_t  packet[4];
+} bench_event_t;
+
+typedef struct
+{
+	bench_event_t *event;
+	size_t n_event;
+	size_t capacity;
+	uint32_t seq;
+} bench_corpus_t;
+
+static const uint8_t _cin_size_tbl[16] = 
+{
+	0, 0, 2, 3, 3, 1, 2, 3, 3, 3, 3, 3, 2, 2, 3, 1
+};
+
+static void corpus_push(bench_corpus_t *corpus, uint32_t tick, uint8_t cin, uint8_t b0, uint8_t b1, uint8_t b2)
+{
+	bench_event_t *ev = NULL;
+
+	if ( corpus->n_event == corpus->capacity )
+	{
+		corpus->capacity = corpus->capacity ? corpus->capacity * 2 : 1024;
+		corpus->event = realloc(corpus->event, corpus->capacity * sizeof(bench_event_t));
+		if ( corpus->event == NULL )
+		{
+			fprintf(stderr, "out of memory\n");
+			exit(1);
+		}
+	}
+
+	ev = &corpus->event[corpus->n_event++];
+	ev->tick = tick;
+	ev->seq = corpus->seq++;
+	ev->packet[0] = cin;
+	ev->packet[1] = b0;
+	ev->packet[2] = b1;
+	ev->packet[3] = b2;
+}
+
+// SysEx data (without F0) into CIN 0x4-0x7 packets.
+static void corpus_push_sysex(bench_corpus_t *corpus, uint32_t tick, const uint8_t *dat, size_t len)
+{
+	uint8_t buf[3];
+	size_t n = 0;
+	size_t i = 0;
+
+	buf[n++] = 0xF0;
+	for ( i = 0; i < len; i++ )
+	{
+		buf[n++] = dat[i];
+		if ( dat[i] == 0xF7 )
+		{
+			break;
+		}
+		if ( n == 3 )
+		{
+			corpus_push(corpus, tick, 0x4, buf[0], buf[1], buf[2]);
+			n = 0;
+		}
+	}
+
+	if ( ( n == 0 ) || ( buf[n-1] != 0xF7 ) )
+	{// terminate
+		buf[n++] = 0xF7;
+		if ( n > 3 )
+		{
+			corpus_push(corpus, tick, 0x4, buf[0], buf[1], buf[2]);
+			buf[0] = 0xF7;
+			n = 1;
+		}
+	}
+	corpus_push(corpus, tick, 0x4 + n, buf[0], n > 1 ? buf[1] : 0, n > 2 ? buf[2] : 0);
+}
+
+static int compare_event(const void *a, const void *b)
+{
+	const bench_event_t *ea = a;
+	const bench_event_t *eb = b;
+
+	if ( ea->tick != eb->tick )
+	{
+		return ( ea->tick < eb->tick ) ? -1 : 1;
+	}
+	return ( ea->seq < eb->seq ) ? -1 : ( ea->seq > eb->seq );
+}
+
+static uint32_t read_be(const uint8_t *p, size_t n)
+{
+	uint32_t v = 0;
+	while ( n-- )
+	{
+		v = (v << 8) | *p++;
+	}
+	return v;
+}
+
+static int read_vlq(const uint8_t **pp, const uint8_t *end, uint32_t *out)
+{
+	uint32_t v = 0;
+	int i = 0;
+
+	for ( i = 0; i < 4; i++ )
+	{
+		if ( *pp >= end )
+		{
+			return -1;
+		}
+		v = (v << 7) | (**pp & 0x7F);
+		if ( ( *(*pp)++ & 0x80 ) == 0 )
+		{
+			*out = v;
+			return 0;
+		}
+	}
+	return -1;
+}
+
+// tracks of a standard MIDI file are merged in time order. the timing itself is not replayed.
+static int load_smf(const char *path, bench_corpus_t *corpus)
+{
+	FILE *fp = NULL;
+	uint8_t *file = NULL;
+	long size = 0;
+	const uint8_t *p = NULL;
+	const uint8_t *end = NULL;
+	uint32_t n_track = 0;
+	uint32_t trk = 0;
+
+	fp = fopen(path, "rb");
+	if ( fp == NULL )
+	{
+		perror(path);
+		return -1;
+	}
+	fseek(fp, 0, SEEK_END);
+	size = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+	file = malloc(size);
+	if ( ( file == NULL ) || ( fread(file, 1, size, fp) != (size_t)size ) )
+	{
+		fprintf(stderr, "%s: read error\n", path);
+		fclose(fp);
+		free(file);
+		return -1;
+	}
+	fclose(fp);
+
+	if ( ( size < 14 ) || memcmp(file, "MThd", 4) )
+	{
+		fprintf(stderr, "%s: not a standard MIDI file\n", path);
+		free(file);
+		return -1;
+	}
+	n_track = read_be(&file[10], 2);
+	p = &file[8 + read_be(&file[4], 4)];
+	end = &file[size];
+
+	for ( trk = 0; ( trk < n_track ) && ( p + 8 <= end ); trk++ )
+	{
+		uint32_t len = read_be(&p[4], 4);
+		const uint8_t *trk_end = p + 8 + len;
+		uint32_t tick = 0;
+		uint8_t running = 0;
+		int is_track = !memcmp(p, "MTrk", 4);
+
+		if ( trk_end > end )
+		{
+			trk_end = end;
+		}
+		p += 8;
+
+		while ( is_track && ( p < trk_end ) )
+		{
+			uint32_t delta = 0;
+			uint8_t st = 0;
+
+			if ( read_vlq(&p, trk_end, &delta) || ( p >= trk_end ) )
+			{
+				break;
+			}
+			tick += delta;
+
+			st = *p;
+			if ( st & 0x80 )
+			{
+				p++;
+			}
+			else
+			{// running status
+				st = running;
+			}
+
+			if ( st == 0xFF )
+			{// meta event
+				uint32_t mlen = 0;
+				p++; // type
+				if ( read_vlq(&p, trk_end, &mlen) )
+				{
+					break;
+				}
+				p += mlen;
+			}
+			else if ( ( st == 0xF0 ) || ( st == 0xF7 ) )
+			{
+				uint32_t slen = 0;
+				if ( read_vlq(&p, trk_end, &slen) || ( p + slen > trk_end ) )
+				{
+					break;
+				}
+				if ( st == 0xF0 )
+				{
+					corpus_push_sysex(corpus, tick, p, slen);
+				}
+				p += slen;
+				running = 0;
+			}
+			else if ( st >= 0x80 )
+			{
+				size_t n = _cin_size_tbl[st >> 4] - 1;
+				if ( p + n > trk_end )
+				{
+					break;
+				}
+				corpus_push(corpus, tick, st >> 4, st, p[0], n > 1 ? p[1] : 0);
+				p += n;
+				running = st;
+			}
+			else
+			{// data byte without running status
+				break;
+			}
+		}
+		p = trk_end;
+	}
+
+	free(file);
+	qsort(corpus->event, corpus->n_event, sizeof(bench_event_t), compare_event);
+	return 0;
+}
+
+// chords, controller automation and pitch bend on 4 channels.
+static void make_synthetic_corpus(bench_corpus_t *corpus)
+{
+	uint32_t seed = 1;
+	uint32_t beat = 0;
+	uint32_t ch = 0;
+	uint32_t i = 0;
+	uint8_t key[4][3];
+
+	for ( beat = 0; beat < 2000; beat++ )
+	{
+		for ( ch = 0; ch < 4; ch++ )
+		{
+			if ( ( beat % 64 ) == 0 )
+			{
+				corpus_push(corpus, beat, 0xC, 0xC0 | ch, (beat / 64 + ch * 8) & 0x7F, 0);
+			}
+			for ( i = 0; i < 3; i++ )
+			{
+				seed = seed * 1103515245 + 12345;
+				key[ch][i] = 36 + ((seed >> 16) % 48);
+				corpus_push(corpus, beat, 0x9, 0x90 | ch, key[ch][i], 64 + ((seed >> 8) & 0x3F));
+			}
+			for ( i = 0; i < 8; i++ )
+			{
+				corpus_push(corpus, beat, 0xB, 0xB0 | ch, ( i & 1 ) ? 11 : 7, (beat + i * 16) & 0x7F);
+				corpus_push(corpus, beat, 0xE, 0xE0 | ch, (beat * 8 + i) & 0x7F, (64 + ((beat + i) & 0x1F)) & 0x7F);
+			}
+			for ( i = 0; i < 3; i++ )
+			{
+				corpus_push(corpus, beat, 0x8, 0x80 | ch, key[ch][i], 0);
+			}
+		}
+	}
+}
+
+static double now_sec(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static void run(const char *name, const bench_corpus_t *corpus, uint32_t repeat)
+{
+	uint8_t *stream = NULL;
+	size_t stream_len = corpus->n_event * 4;
+	uint64_t midi_bytes = 0;
+	uint64_t n_event = 0;
+	host_hal_stat_t stat;
+	YMF825_ToneUploadStat_t tone_upload_stat;
+	usb_midi_coalesce_stat_t coalesce_stat;
+	double t0 = 0.0;
+	double t = 0.0;
+	size_t i = 0;
+	uint32_t r = 0;
+
+	stream = malloc(stream_len ? stream_len : 1);
+	for ( i = 0; i < corpus->n_event; i++ )
+	{
+		memcpy(&stream[i * 4], corpus->event[i].packet, 4);
+		midi_bytes += _cin_size_tbl[corpus->event[i].packet[0] & 0x0F];
+	}
+
+	host_hal_reset_stat();
+#ifdef USE_LATENCY_STAT
+	latency_stat_reset();
+#endif
+	t0 = now_sec();
+	for ( r = 0; r < repeat; r++ )
+	{
+		for ( i = 0; i < stream_len; i += BENCH_USB_PACKET_SIZE )
+		{
+			size_t len = stream_len - i;
+#ifdef USE_LATENCY_STAT
+			// taken by midi_cdc_data_out() on the target.
+			latency_stat_set_rx_stamp(LATENCY_STAT_NOW());
+#endif
+			// the usb driver passes the packet again while the queue is full.
+			while ( usb_midi_receive_irq(&stream[i], len < BENCH_USB_PACKET_SIZE ? len : BENCH_USB_PACKET_SIZE) != 0 )
+			{
+				usb_midi_task();
+			}
+			usb_midi_task();
+		}
+	}
+	// finish the pending tone upload and the messages held by it.
+	while ( YMF825_IsToneUploadBusy() )
+	{
+		usb_midi_task();
+	}
+	usb_midi_task();
+	t = now_sec() - t0;
+	host_hal_get_stat(&stat);
+	YMF825_GetToneUploadStat(&tone_upload_stat);
+	get_usb_midi_coalesce_stat(&coalesce_stat);
+	free(stream);
+
+	n_event = (uint64_t)corpus->n_event * repeat;
+	midi_bytes *= repeat;
+
+	printf("%s\n", name);
+	printf("  events          : %llu (%zu x %u)\n", (unsigned long long)n_event, corpus->n_event, repeat);
+	printf("  time            : %.3f s\n", t);
+	printf("  events/s        : %.0f\n", t > 0 ? n_event / t : 0.0);
+	printf("  MIDI bytes/s    : %.0f\n", t > 0 ? midi_bytes / t : 0.0);
+	if ( n_event )
+	{
+		printf("  SPI1 bytes/event: %.3f (YMF825)\n", (double)stat.spi_bytes[1] / n_event);
+		printf("  SPI1 NSS/event  :");
+		for ( uint32_t nss = YMF825_GetNssPins(); nss != 0; nss &= nss - 1 )
+		{// one column for each NSS pin, in the order of the pin number.
+			printf(" %.3f", (double)stat.gpio_reset[1][__builtin_ctz(nss)] / n_event);
+		}
+		printf("\n");
+		printf("  SPI0 bytes/event: %.3f (YMZ294)\n", (double)stat.spi_bytes[0] / n_event);
+		printf("  tone uploads    : %lu (merged %lu)\n",
+			(unsigned long)tone_upload_stat.upload_count, (unsigned long)tone_upload_stat.merge_count);
+		printf("  coalesced       : cc %lu, bend %lu, pressure %lu\n",
+			(unsigned long)coalesce_stat.cc_count, (unsigned long)coalesce_stat.pitch_bend_count,
+			(unsigned long)coalesce_stat.pressure_count);
+		printf("  notes ahead     : %lu\n", (unsigned long)get_usb_midi_note_lane_count());
+#ifdef USE_LATENCY_STAT
+		for ( uint32_t stage = 0; stage < NUM_OF_LATENCY_STAGE; stage++ )
+		{
+			latency_summary_t summary;
+			latency_stat_get_summary((latency_stage_t)stage, &summary);
+			printf("  latency %-8s: min %lu, avg %lu, max %lu, p99 %lu cycles (n %lu)\n",
+				latency_stat_stage_name((latency_stage_t)stage),
+				(unsigned long)summary.min, (unsigned long)summary.avg,
+				(unsigned long)summary.max, (unsigned long)summary.p99, (unsigned long)summary.count);
+		}
+		printf("  latency skipped : %lu\n", (unsigned long)latency_stat_get_skipped_count());
+#endif
+	}
+}
+
+// the former code of the engines.
+static void pow_pitch_bend_ymf825(uint8_t sens, uint16_t shift, uint16_t *INT, uint16_t *FRAC)
+{
+	uint16_t pitch = 0;
+	float fratio = (float)pow(2.0, (double)sens / 12.0 * (double)(shift-8192) / 8192.0);
+
+	pitch = (uint16_t)(512.0F * fratio);
+	if ( pitch >= 2048)
+	{
+		pitch = 2047;
+	}
+	*INT = (pitch >> 9) & 0x03;
+	*FRAC = pitch & 0x1FF;
+}
+
+static uint16_t pow_pitch_bend_ymz294(uint8_t sens, uint16_t shift, uint16_t tp)
+{
+	float fratio = (float)pow(2.0, (double)sens / 12.0 * (double)(shift-8192) / 8192.0 * -1);
+
+	return tp * fratio;
+}
+
+static void run_pitch_bend(uint32_t repeat)
+{
+	const uint16_t tp = 0x0400; // around A3 of the YMZ294 at 4 MHz
+	volatile uint32_t sink = 0;
+	uint32_t n_op = 0;
+	uint32_t max_err825 = 0;
+	uint32_t max_err294 = 0;
+	double t_pow = 0.0;
+	double t_int = 0.0;
+	double t0 = 0.0;
+	uint32_t r = 0;
+	uint32_t sens = 0;
+	uint32_t shift = 0;
+	uint16_t INT = 0;
+	uint16_t FRAC = 0;
+	uint16_t INT_ref = 0;
+	uint16_t FRAC_ref = 0;
+	int32_t err = 0;
+
+	// accuracy
+	for ( sens = 0; sens <= PITCH_BEND_MAX_SENSITIVITY; sens++ )
+	{
+		for ( shift = 0; shift < 16384; shift++ )
+		{
+			pow_pitch_bend_ymf825(sens, shift, &INT_ref, &FRAC_ref);
+			PitchBend_ToYMF825(PitchBend_GetFreqRatio(sens, shift), &INT, &FRAC);
+			err = (int32_t)((INT << 9) | FRAC) - (int32_t)((INT_ref << 9) | FRAC_ref);
+			if ( (uint32_t)abs(err) > max_err825 )
+			{
+				max_err825 = abs(err);
+			}
+			err = (int32_t)PitchBend_ScaleTp(tp, PitchBend_GetTpRatio(sens, shift))
+				- (int32_t)pow_pitch_bend_ymz294(sens, shift, tp);
+			if ( ( pow_pitch_bend_ymz294(sens, shift, tp) <= 0x0FFF ) && ( (uint32_t)abs(err) > max_err294 ) )
+			{
+				max_err294 = abs(err);
+			}
+		}
+	}
+
+	// speed
+	t0 = now_sec();
+	for ( r = 0; r < repeat; r++ )
+	{
+		for ( sens = 0; sens <= PITCH_BEND_MAX_SENSITIVITY; sens++ )
+		{
+			for ( shift = 0; shift < 16384; shift += 7 )
+			{
+				pow_pitch_bend_ymf825(sens, shift, &INT, &FRAC);
+				sink += INT + FRAC + pow_pitch_bend_ymz294(sens, shift, tp);
+				n_op++;
+			}
+		}
+	}
+	t_pow = now_sec() - t0;
+
+	t0 = now_sec();
+	for ( r = 0; r < repeat; r++ )
+	{
+		for ( sens = 0; sens <= PITCH_BEND_MAX_SENSITIVITY; sens++ )
+		{
+			for ( shift = 0; shift < 16384; shift += 7 )
+			{
+				PitchBend_ToYMF825(PitchBend_GetFreqRatio(sens, shift), &INT, &FRAC);
+				sink += INT + FRAC + PitchBend_ScaleTp(tp, PitchBend_GetTpRatio(sens, shift));
+			}
+		}
+	}
+	t_int = now_sec() - t0;
+	(void)sink;
+
+	// one op: YMF825 INT/FRAC and YMZ294 TP of one bend message.
+	printf("pitch bend (sens 0-24, 14-bit bend)\n");
+	printf("  ops             : %lu\n", (unsigned long)n_op);
+	printf("  pow()   ns/op   : %.1f\n", n_op ? t_pow * 1e9 / n_op : 0.0);
+	printf("  integer ns/op   : %.1f\n", n_op ? t_int * 1e9 / n_op : 0.0);
+	printf("  max error       : YMF825 %lu LSB, YMZ294 TP %lu\n", (unsigned long)max_err825, (unsigned long)max_err294);
+}
+
+static uint64_t now_cycles(void)
+{
+#ifdef BENCH_HAS_TSC
+	return __rdtsc();
+#else
+	return 0;
+#endif
+}
+
+static void run_note_engine(const char *name, const MIDI_Message_Callbacks_t *cb, uint32_t repeat)
+{
+	const MIDI_ChannelVoiceMessage_t *msg = &cb->channel.voice_msg;
+	uint32_t n_note = 0;
+	uint32_t seed = 1;
+	uint32_t r = 0;
+	uint32_t i = 0;
+	uint8_t ch = 0;
+	uint8_t kk = 0;
+	uint8_t vv = 0;
+	uint64_t c0 = 0;
+	uint64_t cycles = 0;
+	double t0 = 0.0;
+	double t = 0.0;
+
+	t0 = now_sec();
+	c0 = now_cycles();
+	for ( r = 0; r < repeat; r++ )
+	{
+		for ( i = 0; i < 10000; i++ )
+		{
+			seed = seed * 1103515245 + 12345;
+			ch = (seed >> 8) & 0x03;
+			kk = 36 + ((seed >> 16) % 48);
+			vv = 1 + ((seed >> 24) & 0x7E);
+			msg->pNoteOn(ch, kk, vv);
+			msg->pNoteOff(ch, kk, 0);
+			n_note++;
+		}
+	}
+	cycles = now_cycles() - c0;
+	t = now_sec() - t0;
+
+	printf("  %-10s: %.1f ns/note", name, t * 1e9 / n_note);
+#ifdef BENCH_HAS_TSC
+	printf(", %.0f cycles/note", (double)cycles / n_note);
+#endif
+	printf("\n");
+}
+
+static void run_note(uint32_t repeat)
+{
+	printf("note on/off pair (4 channels)\n");
+	run_note_engine("mode4", MIDI_Mode4_YMF825_Init(), repeat);
+	MIDI_Mode4_YMF825_DeInit();
+	run_note_engine("music box", MIDI_MUSIC_BOX_YMF825_Init(), repeat);
+	MIDI_MUSIC_BOX_YMF825_DeInit();
+	run_note_engine("poly", MIDI_Poly_YMF825_Init(), repeat);
+	MIDI_Poly_YMF825_DeInit();
+	run_note_engine("ymz294", midi_ymz294_init(), repeat);
+	midi_ymz294_deinit();
+}
+
+int main(int argc, char *argv[])
+{
+	uint32_t repeat = BENCH_DEFAULT_REPEAT;
+	ymf825_sound_driver_t driver = YMF825_SOUND_DRIVER_MUSIC_BOX;
+	FILE *trace = NULL;
+	int pitch_bend = 0;
+	int note = 0;
+	int n_file = 0;
+	int i = 0;
+
+	for ( i = 1; i < argc; i++ )
+	{
+		if ( !strcmp(argv[i], "-r") && ( i + 1 < argc ) )
+		{
+			repeat = strtoul(argv[++i], NULL, 0);
+		}
+		else if ( !strcmp(argv[i], "-d") && ( i + 1 < argc ) )
+		{
+			i++;
+			driver = !strcmp(argv[i], "mode4") ? YMF825_SOUND_DRIVER_MODE4
+				   : !strcmp(argv[i], "poly") ? YMF825_SOUND_DRIVER_POLY
+				   : YMF825_SOUND_DRIVER_MUSIC_BOX;
+		}
+		else if ( !strcmp(argv[i], "-p") )
+		{
+			pitch_bend = 1;
+		}
+		else if ( !strcmp(argv[i], "-n") )
+		{
+			note = 1;
+		}
+		else if ( !strcmp(argv[i], "-t") && ( i + 1 < argc ) )
+		{
+			trace = fopen(argv[++i], "w");
+		}
+		else
+		{
+			argv[++n_file] = argv[i];
+		}
+	}
+
+	if ( pitch_bend )
+	{
+		run_pitch_bend(repeat);
+		return 0;
+	}
+
+	init_freerun_timer();
+	if ( note )
+	{
+		run_note(repeat);
+		return 0;
+	}
+	init_usb_midi_app();
+	switch_ymf825_sound_driver(driver);
+	// the driver is switched on the next call.
+	usb_midi_task();
+
+	host_hal_set_trace(trace);
+
+	if ( n_file == 0 )
+	{
+		bench_corpus_t corpus = { 0 };
+		make_synthetic_corpus(&corpus);
+		run("synthetic", &corpus, repeat);
+		free(corpus.event);
+	}
+	for ( i = 1; i <= n_file; i++ )
+	{
+		bench_corpus_t corpus = { 0 };
+		if ( load_smf(argv[i], &corpus) == 0 )
+		{
+			run(argv[i], &corpus, repeat);
+		}
+		free(corpus.event);
+	}
+
+	if ( trace )
+	{
+		fclose(trace);
+	}
+
+	return 0;
+}
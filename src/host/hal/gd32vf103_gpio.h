@@ -0,0 +1,58 @@
+/*
+  MIT License
+
+  Copyright (c) 2020 nyannkov
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+#ifndef GD32VF103_GPIO_H
+#define GD32VF103_GPIO_H
+
+// stub of the GD32VF103 GPIO driver for the host build.
+
+#include "host_hal.h"
+
+#define GPIOA		0U
+#define GPIOB		1U
+
+#ifndef BIT
+#define BIT(x)		((uint32_t)((uint32_t)0x01U<<(x)))
+#endif
+
+#define GPIO_PIN_0	BIT(0)
+#define GPIO_PIN_1	BIT(1)
+#define GPIO_PIN_2	BIT(2)
+#define GPIO_PIN_3	BIT(3)
+#define GPIO_PIN_4	BIT(4)
+#define GPIO_PIN_5	BIT(5)
+#define GPIO_PIN_6	BIT(6)
+#define GPIO_PIN_7	BIT(7)
+#define GPIO_PIN_8	BIT(8)
+#define GPIO_PIN_9	BIT(9)
+#define GPIO_PIN_10	BIT(10)
+#define GPIO_PIN_11	BIT(11)
+#define GPIO_PIN_12	BIT(12)
+#define GPIO_PIN_13	BIT(13)
+#define GPIO_PIN_14	BIT(14)
+#define GPIO_PIN_15	BIT(15)
+
+extern void gpio_bit_set(uint32_t gpio_periph, uint32_t pin);
+extern void gpio_bit_reset(uint32_t gpio_periph, uint32_t pin);
+
+#endif /* GD32VF103_GPIO_H */
@@ -0,0 +1,69 @@
+/*
+  MIT License
+
+  Copyright (c) 2020 nyannkov
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+#ifndef GD32VF103_SPI_H
+#define GD32VF103_SPI_H
+
+// stub of the GD32VF103 SPI driver for the host build.
+// a byte written to SPI_DATA is recorded when SPI_STAT is polled next,
+// and the transmission always completes at once. received data is 0x00.
+
+#include "host_hal.h"
+
+#define SPI0				0U
+#define SPI1				1U
+
+#define SPI_DATA(spix)			(*host_spi_data_reg(spix))
+#define SPI_STAT(spix)			host_spi_stat(spix)
+
+#define SPI_STAT_RBNE			(1U << 0)
+#define SPI_STAT_TBE			(1U << 1)
+#define SPI_STAT_TRANS			(1U << 7)
+
+#define SPI_MASTER			0U
+#define SPI_TRANSMODE_FULLDUPLEX	0U
+#define SPI_FRAMESIZE_8BIT		0U
+#define SPI_NSS_SOFT			0U
+#define SPI_ENDIAN_MSB			0U
+#define SPI_CK_PL_LOW_PH_1EDGE		0U
+#define SPI_CK_PL_HIGH_PH_2EDGE		3U
+#define SPI_PSC_16			3U
+
+typedef struct
+{
+	uint32_t device_mode;
+	uint32_t trans_mode;
+	uint32_t frame_size;
+	uint32_t nss;
+	uint32_t endian;
+	uint32_t clock_polarity_phase;
+	uint32_t prescale;
+} spi_parameter_struct;
+
+extern void spi_i2s_deinit(uint32_t spi_periph);
+extern void spi_struct_para_init(spi_parameter_struct *spi_struct);
+extern void spi_init(uint32_t spi_periph, spi_parameter_struct *spi_struct);
+extern void spi_enable(uint32_t spi_periph);
+extern void spi_disable(uint32_t spi_periph);
+
+#endif /* GD32VF103_SPI_H */
@@ -0,0 +1,81 @@
+/*
+  MIT License
+
+  Copyright (c) 2020 nyannkov
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+#ifndef GD32VF103_TIMER_H
+#define GD32VF103_TIMER_H
+
+// stub of the GD32VF103 TIMER driver for the host build.
+// TIMER_CNT advances by one on every read, so busy-wait delays finish at once.
+
+#include "host_hal.h"
+
+#define TIMER1				1U
+#define TIMER5				5U
+
+#define TIMER_CNT(timerx)		host_timer_cnt(timerx)
+
+#define TIMER_CH_1			1U
+#define TIMER_CKDIV_DIV1		0U
+#define TIMER_COUNTER_EDGE		0U
+#define TIMER_COUNTER_UP		0U
+#define TIMER_CCX_ENABLE		1U
+#define TIMER_CCXN_DISABLE		0U
+#define TIMER_OC_POLARITY_HIGH		0U
+#define TIMER_OCN_POLARITY_HIGH		0U
+#define TIMER_OC_IDLE_STATE_LOW		0U
+#define TIMER_OCN_IDLE_STATE_LOW	0U
+#define TIMER_OC_MODE_PWM0		0U
+#define TIMER_OC_SHADOW_DISABLE		0U
+
+typedef struct
+{
+	uint16_t prescaler;
+	uint16_t alignedmode;
+	uint16_t counterdirection;
+	uint16_t clockdivision;
+	uint32_t period;
+	uint8_t  repetitioncounter;
+} timer_parameter_struct;
+
+typedef struct
+{
+	uint16_t outputstate;
+	uint16_t outputnstate;
+	uint16_t ocpolarity;
+	uint16_t ocnpolarity;
+	uint16_t ocidlestate;
+	uint16_t ocnidlestate;
+} timer_oc_parameter_struct;
+
+extern void timer_deinit(uint32_t timer_periph);
+extern void timer_struct_para_init(timer_parameter_struct *initpara);
+extern void timer_init(uint32_t timer_periph, timer_parameter_struct *initpara);
+extern void timer_enable(uint32_t timer_periph);
+extern void timer_auto_reload_shadow_enable(uint32_t timer_periph);
+extern void timer_channel_output_struct_para_init(timer_oc_parameter_struct *ocpara);
+extern void timer_channel_output_config(uint32_t timer_periph, uint16_t channel, timer_oc_parameter_struct *ocpara);
+extern void timer_channel_output_pulse_value_config(uint32_t timer_periph, uint16_t channel, uint32_t pulse);
+extern void timer_channel_output_mode_config(uint32_t timer_periph, uint16_t channel, uint16_t ocmode);
+extern void timer_channel_output_shadow_config(uint32_t timer_periph, uint16_t channel, uint16_t ocshadow);
+
+#endif /* GD32VF103_TIMER_H */
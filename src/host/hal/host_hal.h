@@ -0,0 +1,56 @@
+/*
+  MIT License
+
+  Copyright (c) 2020 nyannkov
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+#ifndef __HOST_HAL_H__
+#define __HOST_HAL_H__
+
+// stub HAL of the host build. records the SPI and GPIO traffic instead of driving the pins.
+
+#include <stdint.h>
+#include <stdio.h>
+
+#define HOST_SPI_NUM		2
+#define HOST_GPIO_PORT_NUM	2
+#define HOST_GPIO_PIN_NUM	16
+
+typedef struct
+{
+	uint64_t spi_bytes[HOST_SPI_NUM];					// bytes sent on each SPI
+	uint64_t gpio_set[HOST_GPIO_PORT_NUM][HOST_GPIO_PIN_NUM];	// gpio_bit_set calls of each pin
+	uint64_t gpio_reset[HOST_GPIO_PORT_NUM][HOST_GPIO_PIN_NUM];	// gpio_bit_reset calls of each pin
+} host_hal_stat_t;
+
+extern void host_hal_reset_stat(void);
+extern void host_hal_get_stat(host_hal_stat_t *out);
+extern void host_hal_set_trace(FILE *fp);
+
+// register access of the stub peripherals (see gd32vf103_spi.h, gd32vf103_timer.h)
+extern volatile uint32_t *host_spi_data_reg(uint32_t spi_periph);
+extern uint32_t host_spi_stat(uint32_t spi_periph);
+extern uint32_t host_timer_cnt(uint32_t timer_periph);
+
+// CSR access of the stub core (see riscv_encoding.h)
+extern uint32_t host_read_csr_mcycle(void);
+extern void enable_mcycle_minstret(void);
+
+#endif /* __HOST_HAL_H__ */
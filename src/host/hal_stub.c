@@ -0,0 +1,147 @@
+/*
+  MIT License
+
+  Copyright (c) 2020 nyannkov
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+#include <stdarg.h>
+#include <string.h>
+#include <time.h>
+#include "gd32vf103_gpio.h"
+#include "gd32vf103_spi.h"
+#include "gd32vf103_timer.h"
+
+// SPI_DATA value while no byte is waiting to be recorded. reads as 0x00 through uint8_t.
+#define HOST_SPI_DATA_EMPTY	0x100U
+
+static volatile uint32_t _spi_data[HOST_SPI_NUM] = { HOST_SPI_DATA_EMPTY, HOST_SPI_DATA_EMPTY };
+static uint32_t _timer_cnt = 0;
+static host_hal_stat_t _stat;
+static FILE *_trace = NULL;
+
+void host_hal_reset_stat(void)
+{
+	memset(&_stat, 0, sizeof(_stat));
+}
+
+void host_hal_get_stat(host_hal_stat_t *out)
+{
+	*out = _stat;
+}
+
+// NULL: no trace
+void host_hal_set_trace(FILE *fp)
+{
+	_trace = fp;
+}
+
+volatile uint32_t *host_spi_data_reg(uint32_t spi_periph)
+{
+	return &_spi_data[spi_periph];
+}
+
+uint32_t host_spi_stat(uint32_t spi_periph)
+{
+	if ( _spi_data[spi_periph] != HOST_SPI_DATA_EMPTY )
+	{// record the byte written since the last poll.
+		_stat.spi_bytes[spi_periph]++;
+		if ( _trace )
+		{
+			fprintf(_trace, "SPI%u %02X\n", (unsigned)spi_periph, (unsigned)(_spi_data[spi_periph] & 0xFF));
+		}
+		_spi_data[spi_periph] = HOST_SPI_DATA_EMPTY;
+	}
+	return SPI_STAT_TBE;
+}
+
+uint32_t host_timer_cnt(uint32_t timer_periph)
+{
+	(void)timer_periph;
+	return (_timer_cnt++) & 0xFFFF;
+}
+
+// pin may hold several pins, as the BOP/BC registers.
+void gpio_bit_set(uint32_t gpio_periph, uint32_t pin)
+{
+	uint32_t n = 0;
+
+	for ( ; pin != 0; pin &= pin - 1 )
+	{
+		n = (uint32_t)__builtin_ctz(pin);
+		_stat.gpio_set[gpio_periph][n]++;
+		if ( _trace )
+		{
+			fprintf(_trace, "GPIO%c%u 1\n", (int)('A' + gpio_periph), (unsigned)n);
+		}
+	}
+}
+
+// pin may hold several pins, as the BOP/BC registers.
+void gpio_bit_reset(uint32_t gpio_periph, uint32_t pin)
+{
+	uint32_t n = 0;
+
+	for ( ; pin != 0; pin &= pin - 1 )
+	{
+		n = (uint32_t)__builtin_ctz(pin);
+		_stat.gpio_reset[gpio_periph][n]++;
+		if ( _trace )
+		{
+			fprintf(_trace, "GPIO%c%u 0\n", (int)('A' + gpio_periph), (unsigned)n);
+		}
+	}
+}
+
+void spi_i2s_deinit(uint32_t spi_periph) { (void)spi_periph; }
+void spi_struct_para_init(spi_parameter_struct *spi_struct) { memset(spi_struct, 0, sizeof(*spi_struct)); }
+void spi_init(uint32_t spi_periph, spi_parameter_struct *spi_struct) { (void)spi_periph; (void)spi_struct; }
+void spi_enable(uint32_t spi_periph) { (void)spi_periph; }
+void spi_disable(uint32_t spi_periph) { (void)spi_periph; }
+
+void timer_deinit(uint32_t timer_periph) { (void)timer_periph; }
+void timer_struct_para_init(timer_parameter_struct *initpara) { memset(initpara, 0, sizeof(*initpara)); }
+void timer_init(uint32_t timer_periph, timer_parameter_struct *initpara) { (void)timer_periph; (void)initpara; }
+void timer_enable(uint32_t timer_periph) { (void)timer_periph; }
+void timer_auto_reload_shadow_enable(uint32_t timer_periph) { (void)timer_periph; }
+void timer_channel_output_struct_para_init(timer_oc_parameter_struct *ocpara) { memset(ocpara, 0, sizeof(*ocpara)); }
+void timer_channel_output_config(uint32_t timer_periph, uint16_t channel, timer_oc_parameter_struct *ocpara) { (void)timer_periph; (void)channel; (void)ocpara; }
+void timer_channel_output_pulse_value_config(uint32_t timer_periph, uint16_t channel, uint32_t pulse) { (void)timer_periph; (void)channel; (void)pulse; }
+void timer_channel_output_mode_config(uint32_t timer_periph, uint16_t channel, uint16_t ocmode) { (void)timer_periph; (void)channel; (void)ocmode; }
+void timer_channel_output_shadow_config(uint32_t timer_periph, uint16_t channel, uint16_t ocshadow) { (void)timer_periph; (void)channel; (void)ocshadow; }
+
+uint32_t host_read_csr_mcycle(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint32_t)(((uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec) * 96 / 1000);
+}
+
+void enable_mcycle_minstret(void) { }
+
+// console of the host build (used by the shell)
+int usb_cdc_printf(const char *format, ...)
+{
+	int ret = 0;
+	va_list args;
+	va_start(args, format);
+	ret = vprintf(format, args);
+	va_end(args);
+	return ret;
+}
@@ -0,0 +1,253 @@
+/*
+  MIT License
+
+  Copyright (c) 2020 nyannkov
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+#include "latency_stat.h"
+
+#ifdef USE_LATENCY_STAT
+#if defined(USE_YMF825_SPI_DMA) || defined(USE_YMZ294_BUS_QUEUE)
+// the SPI transfers complete in the interrupts.
+#include <gd32vf103_eclic.h>
+#define LATENCY_STAT_LOCK()     eclic_global_interrupt_disable()
+#define LATENCY_STAT_UNLOCK()   eclic_global_interrupt_enable()
+#else
+#define LATENCY_STAT_LOCK()
+#define LATENCY_STAT_UNLOCK()
+#endif
+
+// 4 buckets for each power of 2. the bucket n (n >= 4) counts
+// [ (4 + n % 4) << (n / 4 - 1), (5 + n % 4) << (n / 4 - 1) ) cycles.
+// the last one counts the longer ones too (2^24 cycles = 175 ms).
+#define LATENCY_HIST_BUCKET_NUM     96
+
+// note on messages dispatched and waiting for the end of the SPI transfers.
+// as many as the usb midi event queue holds, so a chord queued behind a busy bus is measured whole.
+#ifndef LATENCY_PENDING_NUM
+#define LATENCY_PENDING_NUM         256
+#endif
+
+typedef struct
+{
+	uint32_t count;
+	uint32_t min;
+	uint32_t max;
+	uint64_t sum;
+	uint32_t hist[LATENCY_HIST_BUCKET_NUM];
+} latency_hist_t;
+
+typedef struct
+{
+	uint32_t rx_stamp;
+	uint32_t dispatch_end;
+} latency_pending_t;
+
+// counts the cycles only while enabled. disabled by the startup code.
+extern void enable_mcycle_minstret(void);
+
+static latency_hist_t _hist[NUM_OF_LATENCY_STAGE];
+static latency_pending_t _pending[LATENCY_PENDING_NUM];
+static volatile uint32_t _n_pending;
+static uint32_t _skipped_count; // note on messages left out of the spi and total stages
+static uint32_t _rx_stamp;
+
+static const char * const _stage_name[NUM_OF_LATENCY_STAGE] =
+{
+	"queue",
+	"dispatch",
+	"spi",
+	"total"
+};
+
+static uint32_t get_bucket(uint32_t cycles)
+{
+	uint32_t msb = 0;
+	uint32_t n = 0;
+
+	if ( cycles < 4 )
+	{
+		return cycles;
+	}
+	msb = 31 - __builtin_clz(cycles);
+	n = ((msb - 1) << 2) | ((cycles >> (msb - 2)) & 0x3);
+	return ( n < LATENCY_HIST_BUCKET_NUM ) ? n : LATENCY_HIST_BUCKET_NUM - 1;
+}
+
+// the last cycle count of the bucket.
+static uint32_t get_bucket_max(uint32_t n)
+{
+	uint32_t shift = 0;
+
+	if ( n < 4 )
+	{
+		return n;
+	}
+	shift = (n >> 2) - 1;
+	return ((5 + (n & 0x3)) << shift) - 1;
+}
+
+static void reset_hist(latency_hist_t *hist)
+{
+	uint32_t i = 0;
+
+	hist->count = 0;
+	hist->min = UINT32_MAX;
+	hist->max = 0;
+	hist->sum = 0;
+	for ( i = 0; i < LATENCY_HIST_BUCKET_NUM; i++ )
+	{
+		hist->hist[i] = 0;
+	}
+}
+
+static void add_hist(latency_hist_t *hist, uint32_t cycles)
+{
+	hist->count++;
+	hist->sum += cycles;
+	if ( cycles < hist->min )
+	{
+		hist->min = cycles;
+	}
+	if ( cycles > hist->max )
+	{
+		hist->max = cycles;
+	}
+	hist->hist[get_bucket(cycles)]++;
+}
+
+void init_latency_stat(void)
+{
+	enable_mcycle_minstret();
+	_rx_stamp = LATENCY_STAT_NOW();
+	latency_stat_reset();
+}
+
+// the reception time of the usb packet passed to the receive callback next.
+void latency_stat_set_rx_stamp(uint32_t stamp)
+{
+	_rx_stamp = stamp;
+}
+
+uint32_t latency_stat_get_rx_stamp(void)
+{
+	return _rx_stamp;
+}
+
+void latency_stat_add(latency_stage_t stage, uint32_t cycles)
+{
+	LATENCY_STAT_LOCK();
+	add_hist(&_hist[stage], cycles);
+	LATENCY_STAT_UNLOCK();
+}
+
+// the note on has been passed to the sound drivers.
+// the SPI and TOTAL stages are added by latency_stat_spi_complete().
+void latency_stat_dispatched(uint32_t rx_stamp, uint32_t dispatch_end)
+{
+	LATENCY_STAT_LOCK();
+	if ( _n_pending < LATENCY_PENDING_NUM )
+	{// otherwise counted as skipped.
+		_pending[_n_pending].rx_stamp = rx_stamp;
+		_pending[_n_pending].dispatch_end = dispatch_end;
+		_n_pending++;
+	}
+	else
+	{
+		_skipped_count++;
+	}
+	LATENCY_STAT_UNLOCK();
+}
+
+// call when no SPI transfer is left. ends the pending note on messages.
+void latency_stat_spi_complete(void)
+{
+	uint32_t now = 0;
+	uint32_t i = 0;
+
+	LATENCY_STAT_LOCK();
+	now = LATENCY_STAT_NOW();
+	for ( i = 0; i < _n_pending; i++ )
+	{
+		add_hist(&_hist[LATENCY_STAGE_SPI], now - _pending[i].dispatch_end);
+		add_hist(&_hist[LATENCY_STAGE_TOTAL], now - _pending[i].rx_stamp);
+	}
+	_n_pending = 0;
+	LATENCY_STAT_UNLOCK();
+}
+
+void latency_stat_get_summary(latency_stage_t stage, latency_summary_t *out)
+{
+	const latency_hist_t *hist = &_hist[stage];
+	uint32_t rank = 0;
+	uint32_t n = 0;
+	uint32_t i = 0;
+
+	LATENCY_STAT_LOCK();
+	out->count = hist->count;
+	out->min = ( hist->count > 0 ) ? hist->min : 0;
+	out->max = hist->max;
+	out->avg = ( hist->count > 0 ) ? (uint32_t)(hist->sum / hist->count) : 0;
+	out->p99 = 0;
+	if ( hist->count > 0 )
+	{
+		rank = hist->count - hist->count / 100; // the samples at or below p99
+		for ( i = 0; i < LATENCY_HIST_BUCKET_NUM; i++ )
+		{
+			n += hist->hist[i];
+			if ( n >= rank )
+			{
+				out->p99 = get_bucket_max(i);
+				break;
+			}
+		}
+		if ( out->p99 > hist->max )
+		{
+			out->p99 = hist->max;
+		}
+	}
+	LATENCY_STAT_UNLOCK();
+}
+
+void latency_stat_reset(void)
+{
+	uint32_t i = 0;
+
+	LATENCY_STAT_LOCK();
+	for ( i = 0; i < NUM_OF_LATENCY_STAGE; i++ )
+	{
+		reset_hist(&_hist[i]);
+	}
+	_n_pending = 0;
+	_skipped_count = 0;
+	LATENCY_STAT_UNLOCK();
+}
+
+// note on messages not measured in the spi and total stages, since too many waited for the SPI.
+uint32_t latency_stat_get_skipped_count(void)
+{
+	return _skipped_count;
+}
+
+const char *latency_stat_stage_name(latency_stage_t stage)
+{
+	return ( stage < NUM_OF_LATENCY_STAGE ) ? _stage_name[stage] : "";
+}
+#endif
\ No newline at end of file
@@ -0,0 +1,65 @@
+/*
+  MIT License
+
+  Copyright (c) 2020 nyannkov
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+#ifndef __LATENCY_STAT_H__
+#define __LATENCY_STAT_H__
+
+#include <stdint.h>
+#include <riscv_encoding.h>
+
+// latency of the note on messages, from the usb reception to the end of the SPI transfers.
+// the timestamps are taken from the mcycle counter (96 MHz).
+
+#define LATENCY_STAT_NOW()          ((uint32_t)read_csr(mcycle))
+#define LATENCY_STAT_CYCLE_PER_US   96
+
+typedef enum
+{
+	LATENCY_STAGE_QUEUE = 0,	// usb reception (midi_cdc_data_out) -> dispatch (usb_midi_task)
+	LATENCY_STAGE_DISPATCH,		// parse and the callbacks of the sound drivers
+	LATENCY_STAGE_SPI,			// return of the callbacks -> the queued SPI transfers complete
+	LATENCY_STAGE_TOTAL,		// usb reception -> the SPI transfers complete
+	NUM_OF_LATENCY_STAGE
+} latency_stage_t;
+
+typedef struct
+{
+	uint32_t count;
+	uint32_t min;	// cycles
+	uint32_t avg;
+	uint32_t max;
+	uint32_t p99;	// upper bound of the histogram bucket
+} latency_summary_t;
+
+extern void init_latency_stat(void);
+extern void latency_stat_set_rx_stamp(uint32_t stamp);
+extern uint32_t latency_stat_get_rx_stamp(void);
+extern void latency_stat_add(latency_stage_t stage, uint32_t cycles);
+extern void latency_stat_dispatched(uint32_t rx_stamp, uint32_t dispatch_end);
+extern void latency_stat_spi_complete(void);
+extern void latency_stat_get_summary(latency_stage_t stage, latency_summary_t *out);
+extern void latency_stat_reset(void);
+extern uint32_t latency_stat_get_skipped_count(void);
+extern const char *latency_stat_stage_name(latency_stage_t stage);
+
+#endif//__LATENCY_STAT_H__
\ No newline at end of file
@@ -27,6 +27,7 @@
 #include "freerun_timer.h"
 #include "usb_midi_app.h"
 #include "usb_cdc_app.h"
+#include "ymf825.h"
 
 #define BLINK_CYCLE			1000000
 
@@ -53,10 +54,19 @@ int  main(void)
 	init_usb_cdc_app();
 
 	// start the usb midi cdc device.
-	init_usbd_midi_cdc(usb_cdc_proc, usb_midi_proc);
+	init_usbd_midi_cdc(usb_cdc_receive_irq, usb_midi_receive_irq);
 
 	while(1)
 	{
+		// play the midi messages received from the usb midi.
+		usb_midi_task();
+
+		// execute the commands received from the usb cdc.
+		usb_cdc_task();
+
+		// pass the usb packets held while the queues were full.
+		usb_rx_service();
+
 		led_blink();
 	}
 
@@ -69,6 +79,10 @@ static void enable_periph_clock(void)
 	rcu_periph_clock_enable(RCU_GPIOA);
 	rcu_periph_clock_enable(RCU_GPIOB);
 	rcu_periph_clock_enable(RCU_SPI1);
+#ifdef USE_YMF825_SPI_DMA
+	// SPI1_TX
+	rcu_periph_clock_enable(RCU_DMA0);
+#endif
 
 	// free-running timer
 	rcu_periph_clock_enable(RCU_TIMER5);
@@ -83,6 +97,10 @@ static void enable_periph_clock(void)
 	rcu_periph_clock_enable(RCU_SPI0);
 	// TIMER1(YMZ294 phiM)
 	rcu_periph_clock_enable(RCU_TIMER1); // pwm Output
+#ifdef USE_YMZ294_BUS_QUEUE
+	// TIMER3(YMZ294 bus writer)
+	rcu_periph_clock_enable(RCU_TIMER3);
+#endif
 #endif
 }
 
@@ -91,8 +109,8 @@ static void config_gpio(void)
 	/* SPI1 GPIO config: SCK/PB13, MOSI/PB15 */
 	gpio_init(GPIOB, GPIO_MODE_AF_PP, GPIO_OSPEED_50MHZ,  GPIO_PIN_13 | GPIO_PIN_15);
 
-	// used as SPI1 NSS but configured as GPIO output.
-	gpio_init(GPIOB, GPIO_MODE_OUT_PP, GPIO_OSPEED_50MHZ, GPIO_PIN_12); 
+	// used as SPI1 NSS but configured as GPIO output. one pin for each YMF825 (PB12 for the first).
+	gpio_init(GPIOB, GPIO_MODE_OUT_PP, GPIO_OSPEED_50MHZ, YMF825_GetNssPins());
 
 	/* SPI1 GPIO config: MISO/PB14 */
 	gpio_init(GPIOB, GPIO_MODE_IN_FLOATING, GPIO_OSPEED_50MHZ, GPIO_PIN_14);
@@ -0,0 +1,120 @@
+/*
+  MIT License
+
+  Copyright (c) 2020 nyannkov
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+#include "pitch_bend.h"
+
+#define BEND_CENTER			8192
+#define SEMITONE_STEP		8192 // sens * (bend - 8192) per semitone
+#define FINE_STEP_SHIFT		7    // 64 steps per semitone
+#define FINE_STEP_MASK		((1 << FINE_STEP_SHIFT) - 1)
+#define YMF825_PITCH_MAX	2047 // INT(2 bits) . FRAC(9 bits)
+#define YMZ294_TP_MAX		0x0FFF
+
+// 2^(n/12) for n = -24 to +24 (Q16)
+static const uint32_t _semitone_ratio_tbl[2*PITCH_BEND_MAX_SENSITIVITY + 1] = {
+	16384, 17358, 18390, 19484, 20643, 21870, 23170,
+	24548, 26008, 27554, 29193, 30929, 32768, 34716,
+	36781, 38968, 41285, 43740, 46341, 49097, 52016,
+	55109, 58386, 61858, 65536, 69433, 73562, 77936,
+	82570, 87480, 92682, 98193, 104032, 110218, 116772,
+	123715, 131072, 138866, 147123, 155872, 165140, 174960,
+	185364, 196386, 208064, 220436, 233544, 247431, 262144,
+};
+
+// 2^(n/64/12) for n = 0 to 64 (Q16)
+static const uint32_t _fine_ratio_tbl[65] = {
+	65536, 65595, 65654, 65714, 65773, 65832, 65892, 65951,
+	66011, 66071, 66130, 66190, 66250, 66309, 66369, 66429,
+	66489, 66549, 66609, 66670, 66730, 66790, 66850, 66911,
+	66971, 67032, 67092, 67153, 67213, 67274, 67335, 67395,
+	67456, 67517, 67578, 67639, 67700, 67761, 67823, 67884,
+	67945, 68007, 68068, 68129, 68191, 68252, 68314, 68376,
+	68438, 68499, 68561, 68623, 68685, 68747, 68809, 68871,
+	68933, 68996, 69058, 69120, 69183, 69245, 69308, 69370,
+	69433,
+};
+
+static uint32_t _GetRatio(int32_t x);
+
+uint32_t PitchBend_GetFreqRatio(uint8_t sens, uint16_t bend) {
+
+	if ( sens > PITCH_BEND_MAX_SENSITIVITY ) {
+		sens = PITCH_BEND_MAX_SENSITIVITY;
+	}
+	return _GetRatio((int32_t)sens * ((int32_t)(bend & 0x3FFF) - BEND_CENTER));
+}
+
+uint32_t PitchBend_GetTpRatio(uint8_t sens, uint16_t bend) {
+
+	if ( sens > PITCH_BEND_MAX_SENSITIVITY ) {
+		sens = PITCH_BEND_MAX_SENSITIVITY;
+	}
+	return _GetRatio(-(int32_t)sens * ((int32_t)(bend & 0x3FFF) - BEND_CENTER));
+}
+
+void PitchBend_ToYMF825(uint32_t freq_ratio, uint16_t *INT, uint16_t *FRAC) {
+
+	uint32_t pitch = freq_ratio >> 7; // Q16 -> Q9
+
+	if ( pitch > YMF825_PITCH_MAX ) {
+		pitch = YMF825_PITCH_MAX;
+	}
+	*INT  = (pitch >> 9) & 0x03;
+	*FRAC = pitch & 0x1FF;
+}
+
+uint16_t PitchBend_ScaleTp(uint16_t tp, uint32_t tp_ratio) {
+
+	uint32_t scaled = (uint32_t)(((uint64_t)tp * tp_ratio) >> 16);
+
+	if ( scaled > YMZ294_TP_MAX ) {
+		scaled = YMZ294_TP_MAX;
+	}
+	return (uint16_t)scaled;
+}
+
+// 2^(x / 8192 / 12) in Q16. x: -24*8192 to +24*8192.
+static uint32_t _GetRatio(int32_t x) {
+
+	int32_t semitone = 0;
+	uint32_t fine = 0;
+	uint32_t idx = 0;
+	uint32_t frac = 0;
+	uint32_t fine_ratio = 0;
+
+	// floor division, the fine part is always positive.
+	if ( x >= 0 ) {
+		semitone = x / SEMITONE_STEP;
+	}
+	else {
+		semitone = -((-x + SEMITONE_STEP - 1) / SEMITONE_STEP);
+	}
+	fine = (uint32_t)(x - semitone * SEMITONE_STEP);
+
+	idx  = fine >> FINE_STEP_SHIFT;
+	frac = fine & FINE_STEP_MASK;
+	fine_ratio = _fine_ratio_tbl[idx]
+		+ (((_fine_ratio_tbl[idx+1] - _fine_ratio_tbl[idx]) * frac) >> FINE_STEP_SHIFT);
+
+	return (uint32_t)(((uint64_t)_semitone_ratio_tbl[semitone + PITCH_BEND_MAX_SENSITIVITY] * fine_ratio) >> 16);
+}
@@ -0,0 +1,51 @@
+/*
+  MIT License
+
+  Copyright (c) 2020 nyannkov
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+#ifndef __PITCH_BEND_H__
+#define __PITCH_BEND_H__
+
+#include <stdint.h>
+
+/*
+	Integer pitch bend
+
+	The ratio 2^(sens * (bend - 8192) / 8192 / 12) is looked up in fixed point (Q16),
+	from a table of the semitones (-24 to +24) and a table of 1/64 semitone steps
+	which is linearly interpolated.
+		sens: pitch bend sensitivity (0-24 semitones)
+		bend: 14-bit pitch bend value (8192: center)
+*/
+
+#define PITCH_BEND_RATIO_ONE		(1UL << 16) // 1.0 in Q16
+#define PITCH_BEND_MAX_SENSITIVITY	24
+
+// frequency ratio (Q16)
+extern uint32_t PitchBend_GetFreqRatio(uint8_t sens, uint16_t bend);
+// period ratio (Q16). the reciprocal of the frequency ratio.
+extern uint32_t PitchBend_GetTpRatio(uint8_t sens, uint16_t bend);
+// YMF825 pitch registers (0x12, 0x13) of the frequency ratio.
+extern void PitchBend_ToYMF825(uint32_t freq_ratio, uint16_t *INT, uint16_t *FRAC);
+// YMZ294 tone period scaled by the period ratio.
+extern uint16_t PitchBend_ScaleTp(uint16_t tp, uint32_t tp_ratio);
+
+#endif /* __PITCH_BEND_H__ */
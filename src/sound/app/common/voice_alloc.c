@@ -0,0 +1,203 @@
+/*
+  MIT License
+
+  Copyright (c) 2020 nyannkov
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+#include <string.h>
+#include "voice_alloc.h"
+
+static void _ListPush(VoiceAlloc_t *va, VoiceAlloc_List_t *list, uint8_t v);
+static void _ListRemove(VoiceAlloc_t *va, VoiceAlloc_List_t *list, uint8_t v);
+static uint8_t _SelectVictim(VoiceAlloc_t *va);
+static void _Assign(VoiceAlloc_t *va, uint8_t v, uint8_t ch, uint8_t key, uint8_t level);
+
+void VoiceAlloc_Init(VoiceAlloc_t *va, uint8_t num_voice, VoiceAlloc_Steal_t steal) {
+
+	uint8_t v = 0;
+
+	if ( num_voice > VOICE_ALLOC_MAX_VOICE )
+	{
+		num_voice = VOICE_ALLOC_MAX_VOICE;
+	}
+
+	memset(va->key_index, VOICE_ALLOC_NONE, sizeof(va->key_index));
+	va->free_list.head = va->free_list.tail = VOICE_ALLOC_NONE;
+	va->active_list.head = va->active_list.tail = VOICE_ALLOC_NONE;
+	va->num_voice = num_voice;
+	va->steal_count = 0;
+	VoiceAlloc_SetSteal(va, steal);
+
+	for ( v = 0; v < num_voice; v++ )
+	{
+		va->voice[v].active = 0;
+		_ListPush(va, &va->free_list, v);
+	}
+}
+
+void VoiceAlloc_SetSteal(VoiceAlloc_t *va, VoiceAlloc_Steal_t steal) {
+
+	va->steal = ( steal < NUM_OF_VOICE_ALLOC_STEAL ) ? steal : VOICE_ALLOC_STEAL_OLDEST;
+}
+
+uint8_t VoiceAlloc_NoteOn(VoiceAlloc_t *va, uint8_t ch, uint8_t key, uint8_t level, uint8_t *off_voice) {
+
+	uint8_t v = VOICE_ALLOC_NONE;
+
+	*off_voice = VOICE_ALLOC_NONE;
+
+	if ( ( ch >= VOICE_ALLOC_MAX_CH ) || ( key >= 128 ) || ( va->num_voice == 0 ) )
+	{
+		return VOICE_ALLOC_NONE;
+	}
+
+	v = va->key_index[ch][key];
+	if ( v != VOICE_ALLOC_NONE )
+	{// the key is already sounding.
+		*off_voice = v;
+		if ( va->steal == VOICE_ALLOC_STEAL_SAME_NOTE )
+		{
+			_ListRemove(va, &va->active_list, v);
+			_Assign(va, v, ch, key, level);
+			return v;
+		}
+		VoiceAlloc_Release(va, v);
+	}
+
+	v = va->free_list.head;
+	if ( v != VOICE_ALLOC_NONE )
+	{
+		_ListRemove(va, &va->free_list, v);
+	}
+	else
+	{
+		v = _SelectVictim(va);
+		_ListRemove(va, &va->active_list, v);
+		va->key_index[va->voice[v].ch][va->voice[v].key] = VOICE_ALLOC_NONE;
+		*off_voice = v;
+		va->steal_count++;
+	}
+
+	_Assign(va, v, ch, key, level);
+
+	return v;
+}
+
+uint8_t VoiceAlloc_NoteOff(VoiceAlloc_t *va, uint8_t ch, uint8_t key) {
+
+	uint8_t v = VOICE_ALLOC_NONE;
+
+	if ( ( ch < VOICE_ALLOC_MAX_CH ) && ( key < 128 ) )
+	{
+		v = va->key_index[ch][key];
+		if ( v != VOICE_ALLOC_NONE )
+		{
+			VoiceAlloc_Release(va, v);
+		}
+	}
+	return v;
+}
+
+void VoiceAlloc_Release(VoiceAlloc_t *va, uint8_t voice) {
+
+	VoiceAlloc_Voice_t *p = (VoiceAlloc_Voice_t *)0;
+
+	if ( voice >= va->num_voice )
+	{
+		return;
+	}
+
+	p = &va->voice[voice];
+	if ( p->active )
+	{
+		va->key_index[p->ch][p->key] = VOICE_ALLOC_NONE;
+		_ListRemove(va, &va->active_list, voice);
+		_ListPush(va, &va->free_list, voice);
+		p->active = 0;
+	}
+}
+
+static void _ListPush(VoiceAlloc_t *va, VoiceAlloc_List_t *list, uint8_t v) {
+
+	va->voice[v].prev = list->tail;
+	va->voice[v].next = VOICE_ALLOC_NONE;
+
+	if ( list->tail != VOICE_ALLOC_NONE )
+	{
+		va->voice[list->tail].next = v;
+	}
+	else
+	{
+		list->head = v;
+	}
+	list->tail = v;
+}
+
+static void _ListRemove(VoiceAlloc_t *va, VoiceAlloc_List_t *list, uint8_t v) {
+
+	uint8_t prev = va->voice[v].prev;
+	uint8_t next = va->voice[v].next;
+
+	if ( prev != VOICE_ALLOC_NONE )
+	{
+		va->voice[prev].next = next;
+	}
+	else
+	{
+		list->head = next;
+	}
+
+	if ( next != VOICE_ALLOC_NONE )
+	{
+		va->voice[next].prev = prev;
+	}
+	else
+	{
+		list->tail = prev;
+	}
+}
+
+static uint8_t _SelectVictim(VoiceAlloc_t *va) {
+
+	uint8_t victim = va->active_list.head;
+	uint8_t v = VOICE_ALLOC_NONE;
+
+	if ( va->steal == VOICE_ALLOC_STEAL_QUIETEST )
+	{// the only case which walks the voices, at most num_voice.
+		for ( v = va->voice[victim].next; v != VOICE_ALLOC_NONE; v = va->voice[v].next )
+		{
+			if ( va->voice[v].level < va->voice[victim].level )
+			{
+				victim = v;
+			}
+		}
+	}
+	return victim;
+}
+
+static void _Assign(VoiceAlloc_t *va, uint8_t v, uint8_t ch, uint8_t key, uint8_t level) {
+
+	va->voice[v].ch = ch;
+	va->voice[v].key = key;
+	va->voice[v].level = level;
+	va->voice[v].active = 1;
+	va->key_index[ch][key] = v;
+	_ListPush(va, &va->active_list, v);
+}
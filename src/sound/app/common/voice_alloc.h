@@ -0,0 +1,96 @@
+/*
+  MIT License
+
+  Copyright (c) 2020 nyannkov
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+#ifndef __VOICE_ALLOC_H__
+#define __VOICE_ALLOC_H__
+
+#include <stdint.h>
+
+/*
+	Voice allocator
+
+	Assigns the notes of 16 MIDI channels to the voices of a sound IC.
+	The released voices are kept in a list in the order of their release and the sounding
+	voices in the order of their note on, and the voice of each (channel, key) is indexed,
+	so that the note on and the note off are done without scanning the voices.
+	When no voice is free, a sounding voice is stolen by the policy of VoiceAlloc_Steal_t.
+*/
+
+#ifndef VOICE_ALLOC_MAX_VOICE
+#define VOICE_ALLOC_MAX_VOICE		64 // up to 4 YMF825
+#endif
+#define VOICE_ALLOC_MAX_CH			16
+#define VOICE_ALLOC_NONE			0xFF
+
+typedef enum
+{
+	VOICE_ALLOC_STEAL_OLDEST = 0,	// the voice keyed on first
+	VOICE_ALLOC_STEAL_QUIETEST,		// the voice of the lowest level (the oldest of them)
+	VOICE_ALLOC_STEAL_SAME_NOTE,	// retrigger the voice already playing the key, the oldest voice otherwise
+	NUM_OF_VOICE_ALLOC_STEAL
+} VoiceAlloc_Steal_t;
+
+typedef struct
+{
+	uint8_t prev;
+	uint8_t next;
+	uint8_t ch;
+	uint8_t key;
+	uint8_t level;
+	uint8_t active;
+} VoiceAlloc_Voice_t;
+
+typedef struct
+{
+	uint8_t head;
+	uint8_t tail;
+} VoiceAlloc_List_t;
+
+typedef struct
+{
+	VoiceAlloc_Voice_t voice[VOICE_ALLOC_MAX_VOICE];
+	VoiceAlloc_List_t free_list;	// released voices, the earliest released first
+	VoiceAlloc_List_t active_list;	// sounding voices, the oldest first
+	uint8_t key_index[VOICE_ALLOC_MAX_CH][128];
+	uint8_t num_voice;
+	uint8_t steal;
+	uint32_t steal_count;
+} VoiceAlloc_t;
+
+extern void VoiceAlloc_Init(VoiceAlloc_t *va, uint8_t num_voice, VoiceAlloc_Steal_t steal);
+extern void VoiceAlloc_SetSteal(VoiceAlloc_t *va, VoiceAlloc_Steal_t steal);
+/*
+	Returns the voice for the note (VOICE_ALLOC_NONE if ch or key is out of range).
+	*off_voice is the voice to be keyed off before the note is played on the returned one
+	(a stolen voice, or the voice which was playing the same key), VOICE_ALLOC_NONE if nothing.
+*/
+extern uint8_t VoiceAlloc_NoteOn(VoiceAlloc_t *va, uint8_t ch, uint8_t key, uint8_t level, uint8_t *off_voice);
+// Returns the voice which was playing the key, VOICE_ALLOC_NONE if none.
+extern uint8_t VoiceAlloc_NoteOff(VoiceAlloc_t *va, uint8_t ch, uint8_t key);
+extern void VoiceAlloc_Release(VoiceAlloc_t *va, uint8_t voice);
+
+// iterates the sounding voices, the oldest first. VOICE_ALLOC_NONE at the end.
+#define VoiceAlloc_FirstActive(va)		((va)->active_list.head)
+#define VoiceAlloc_NextActive(va, v)	((va)->voice[(v)].next)
+
+#endif /* __VOICE_ALLOC_H__ */
@@ -0,0 +1,112 @@
+/*
+  MIT License
+
+  Copyright (c) 2020 nyannkov
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+#include "volume.h"
+
+// 31/127/127 in Q18. rounded up, the result is the same as Volume_GetYMF825Level2 for all the values.
+#define YMF825_GAIN_SHIFT	18
+
+#if VOLUME_VELOCITY_CURVE == VOLUME_CURVE_SQUARE
+static const uint8_t _velocity_curve_tbl[128] = {
+	0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 2, 2,
+	2, 2, 3, 3, 3, 3, 4, 4, 5, 5, 5, 6, 6, 7, 7, 8,
+	8, 9, 9, 10, 10, 11, 11, 12, 13, 13, 14, 15, 15, 16, 17, 17,
+	18, 19, 20, 20, 21, 22, 23, 24, 25, 26, 26, 27, 28, 29, 30, 31,
+	32, 33, 34, 35, 36, 37, 39, 40, 41, 42, 43, 44, 45, 47, 48, 49,
+	50, 52, 53, 54, 56, 57, 58, 60, 61, 62, 64, 65, 67, 68, 70, 71,
+	73, 74, 76, 77, 79, 80, 82, 84, 85, 87, 88, 90, 92, 94, 95, 97,
+	99, 101, 102, 104, 106, 108, 110, 112, 113, 115, 117, 119, 121, 123, 125, 127,
+};
+#elif VOLUME_VELOCITY_CURVE == VOLUME_CURVE_SQRT
+static const uint8_t _velocity_curve_tbl[128] = {
+	0, 11, 16, 20, 23, 25, 28, 30, 32, 34, 36, 37, 39, 41, 42, 44,
+	45, 46, 48, 49, 50, 52, 53, 54, 55, 56, 57, 59, 60, 61, 62, 63,
+	64, 65, 66, 67, 68, 69, 69, 70, 71, 72, 73, 74, 75, 76, 76, 77,
+	78, 79, 80, 80, 81, 82, 83, 84, 84, 85, 86, 87, 87, 88, 89, 89,
+	90, 91, 92, 92, 93, 94, 94, 95, 96, 96, 97, 98, 98, 99, 100, 100,
+	101, 101, 102, 103, 103, 104, 105, 105, 106, 106, 107, 108, 108, 109, 109, 110,
+	110, 111, 112, 112, 113, 113, 114, 114, 115, 115, 116, 117, 117, 118, 118, 119,
+	119, 120, 120, 121, 121, 122, 122, 123, 123, 124, 124, 125, 125, 126, 126, 127,
+};
+#elif VOLUME_VELOCITY_CURVE != VOLUME_CURVE_LINEAR
+#error "VOLUME_VELOCITY_CURVE: unknown curve"
+#endif
+
+// 31 * n/127 (truncated, as the former float code)
+static const uint8_t _ymf825_level_tbl[128] = {
+	0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3,
+	3, 4, 4, 4, 4, 5, 5, 5, 5, 6, 6, 6, 6, 7, 7, 7,
+	7, 8, 8, 8, 8, 9, 9, 9, 9, 10, 10, 10, 10, 10, 11, 11,
+	11, 11, 12, 12, 12, 12, 13, 13, 13, 13, 14, 14, 14, 14, 15, 15,
+	15, 15, 16, 16, 16, 16, 17, 17, 17, 17, 18, 18, 18, 18, 19, 19,
+	19, 19, 20, 20, 20, 20, 20, 21, 21, 21, 21, 22, 22, 22, 22, 23,
+	23, 23, 23, 24, 24, 24, 24, 25, 25, 25, 25, 26, 26, 26, 26, 27,
+	27, 27, 27, 28, 28, 28, 28, 29, 29, 29, 29, 30, 30, 30, 30, 31,
+};
+
+// 15 * n/127
+static const uint8_t _ymz294_level_tbl[128] = {
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1,
+	1, 2, 2, 2, 2, 2, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3,
+	3, 3, 4, 4, 4, 4, 4, 4, 4, 4, 4, 5, 5, 5, 5, 5,
+	5, 5, 5, 6, 6, 6, 6, 6, 6, 6, 6, 6, 7, 7, 7, 7,
+	7, 7, 7, 7, 8, 8, 8, 8, 8, 8, 8, 8, 8, 9, 9, 9,
+	9, 9, 9, 9, 9, 10, 10, 10, 10, 10, 10, 10, 10, 10, 11, 11,
+	11, 11, 11, 11, 11, 11, 12, 12, 12, 12, 12, 12, 12, 12, 12, 13,
+	13, 13, 13, 13, 13, 13, 13, 14, 14, 14, 14, 14, 14, 14, 14, 15,
+};
+
+uint8_t Volume_ApplyVelocityCurve(uint8_t vv) {
+
+#if VOLUME_VELOCITY_CURVE == VOLUME_CURVE_LINEAR
+	return vv & 0x7F;
+#else
+	return _velocity_curve_tbl[vv & 0x7F];
+#endif
+}
+
+uint8_t Volume_GetYMF825Level(uint8_t vol) {
+
+	return _ymf825_level_tbl[vol & 0x7F];
+}
+
+uint8_t Volume_GetYMF825Level2(uint8_t vol0, uint8_t vol1) {
+
+	// the product of two 7-bit values is in 14 bits, the division by the constant is a multiply.
+	return (uint8_t)( ( (uint32_t)(vol0 & 0x7F) * (vol1 & 0x7F) * 31 ) / (127 * 127) );
+}
+
+uint16_t Volume_GetYMF825Gain(uint8_t vol1) {
+
+	return (uint16_t)( ( ((uint32_t)(vol1 & 0x7F) * 31 << YMF825_GAIN_SHIFT) + (127 * 127 - 1) ) / (127 * 127) );
+}
+
+uint8_t Volume_ApplyYMF825Gain(uint8_t vol0, uint16_t gain) {
+
+	return (uint8_t)( ( (uint32_t)(vol0 & 0x7F) * gain ) >> YMF825_GAIN_SHIFT );
+}
+
+uint8_t Volume_GetYMZ294Level(uint8_t vol) {
+
+	return _ymz294_level_tbl[vol & 0x7F];
+}
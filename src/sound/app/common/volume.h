@@ -0,0 +1,58 @@
+/*
+  MIT License
+
+  Copyright (c) 2020 nyannkov
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+#ifndef __VOLUME_H__
+#define __VOLUME_H__
+
+#include <stdint.h>
+
+/*
+	Integer volume
+
+	7-bit MIDI values (velocity, CC#7, CC#11) are mapped to the YMF825 ChVol/VoVol (5 bits)
+	and the YMZ294 level (4 bits) without floating point.
+	The velocity curve is selected at compile time by VOLUME_VELOCITY_CURVE.
+*/
+
+#define VOLUME_CURVE_LINEAR		0 // as received
+#define VOLUME_CURVE_SQUARE		1 // v^2/127, close to the GM recommendation
+#define VOLUME_CURVE_SQRT		2 // sqrt(v/127)*127, louder at the low velocities
+
+#ifndef VOLUME_VELOCITY_CURVE
+#define VOLUME_VELOCITY_CURVE	VOLUME_CURVE_LINEAR
+#endif
+
+// note-on velocity through the velocity curve (0-127).
+extern uint8_t Volume_ApplyVelocityCurve(uint8_t vv);
+// 31 * vol/127
+extern uint8_t Volume_GetYMF825Level(uint8_t vol);
+// 31 * vol0/127 * vol1/127
+extern uint8_t Volume_GetYMF825Level2(uint8_t vol0, uint8_t vol1);
+// gain of vol1 for Volume_ApplyYMF825Gain, to be kept while vol1 does not change.
+extern uint16_t Volume_GetYMF825Gain(uint8_t vol1);
+// Volume_GetYMF825Level2(vol0, vol1) by the gain of vol1.
+extern uint8_t Volume_ApplyYMF825Gain(uint8_t vol0, uint16_t gain);
+// 15 * vol/127
+extern uint8_t Volume_GetYMZ294Level(uint8_t vol);
+
+#endif /* __VOLUME_H__ */
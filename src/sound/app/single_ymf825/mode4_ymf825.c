@@ -24,8 +24,10 @@
 #include "mode4_ymf825.h"
 #include "ymf825.h"
 #include "ymf825_note_table.h"
+#include "ymf825_tone_bank.h"
+#include "pitch_bend.h"
+#include "volume.h"
 #include <string.h> // memcpy
-#include <math.h> // pow
 
 extern const uint8_t ymf825_tone_table[128][30];
 
@@ -33,6 +35,7 @@ extern const uint8_t ymf825_tone_table[128][30];
 #define MAX_TONE_NUMBER		16
 #define MAX_CH_NUMBER		16
 #define NUM_OF_TONE_CFG		30
+#define PROGRAM_NO_NOT_GM	0xFF // noise or tone bank
 
 typedef struct _MIDI_TuningData {
 	uint8_t LSB;
@@ -46,10 +49,19 @@ typedef struct _MIDI_PlayTuning {
 	uint8_t PitchBendSensitibity;
 	uint8_t ChannelVolume;
 	uint8_t Expression;
+	uint16_t PitchBend;
+	// derived values, updated only when the parameters above change.
+	uint8_t VoVol;			// of ChannelVolume
+	uint16_t ChVolGain;		// of Expression (Volume_GetYMF825Gain)
+	uint16_t INT;			// pitch of PitchBend and PitchBendSensitibity
+	uint16_t FRAC;
 }MIDI_PlayTuning_t;
 
 
 static uint8_t _ch_program_tbl[MAX_TONE_NUMBER][NUM_OF_TONE_CFG];
+static uint8_t _ch_program_no[MAX_TONE_NUMBER];
+// slots of _ch_program_tbl which differ from the tone memory of the chip.
+static uint16_t _dirty_tone_mask;
 static uint8_t _tone_noise[NUM_OF_TONE_CFG] ={
   0x01,0x80,
   0x00,0x0F,0xF0,0x00,0x00,0x10,0x07,
@@ -61,6 +73,11 @@ static uint8_t _tone_noise[NUM_OF_TONE_CFG] ={
 static MIDI_PlayTuning_t _play_tuning[MAX_CH_NUMBER];
 
 static void _ResetChannelSetting(uint8_t ch);
+static void _UpdateVolumeCache(uint8_t ch);
+static void _UpdatePitchCache(uint8_t ch);
+static void _SetProgram(uint8_t ch, const uint8_t *tone, uint8_t program_no);
+static void _UploadDirtyTones(void);
+static void _ApplyToneBank(uint8_t bank[YMF825_TONE_BANK_SLOT_NUM][YMF825_TONE_BANK_BLOCK_SIZE]);
 
 static void _ymf825_NoteOff(uint8_t ch, uint8_t kk, uint8_t uu);
 static void _ymf825_NoteOn(uint8_t ch, uint8_t kk, uint8_t vv);
@@ -93,25 +110,30 @@ static const MIDI_Message_Callbacks_t _ymf825_midi_msg_callbacks = {
 	}
 };
 
-MIDI_Handle_t *MIDI_Mode4_YMF825_Init(void) {
+const MIDI_Message_Callbacks_t *MIDI_Mode4_YMF825_Init(void) {
 
 	uint8_t i = 0;
-	MIDI_Handle_t *phMIDI = NULL;
 
 	YMF825_Init();
 
+	// the tone memory of the chip is unknown.
+	_dirty_tone_mask = 0xFFFF;
+	for ( i = 0; i < MAX_TONE_NUMBER; i++ ) {
+		_ch_program_no[i] = PROGRAM_NO_NOT_GM;
+	}
+
 	for ( i = 0; i < 16; i++ ) {
 		_ResetChannelSetting(i);
 	}
 
-	phMIDI = MIDI_Init(&_ymf825_midi_msg_callbacks);
+	SetApplyHook_ToneBank_YMF825(_ApplyToneBank);
 
-	return phMIDI;
+	return &_ymf825_midi_msg_callbacks;
 }
 
-void MIDI_Mode4_YMF825_DeInit(MIDI_Handle_t *phMIDI) {
+void MIDI_Mode4_YMF825_DeInit(void) {
 
-	MIDI_DeInit(phMIDI);
+	SetApplyHook_ToneBank_YMF825(NULL);
 }
 
 static void _ymf825_NoteOff(uint8_t ch, uint8_t kk, uint8_t uu) {
@@ -121,8 +143,7 @@ static void _ymf825_NoteOff(uint8_t ch, uint8_t kk, uint8_t uu) {
 	(void)kk;
 	(void)uu;
 	// note off
-	YMF825_SelectChannel(ch);
-	YMF825_KeyOff(tone_num);
+	YMF825_KeyOffVoice(ch, tone_num);
 }
 
 static void _ymf825_NoteOn(uint8_t ch, uint8_t kk, uint8_t vv) { 
@@ -131,34 +152,23 @@ static void _ymf825_NoteOn(uint8_t ch, uint8_t kk, uint8_t vv) {
 	tone_num = ch;
 
 	if (vv != 0x00 ) {
-		float fvelocity = 0.0F;
-		uint8_t ChVol = 0;
-		uint8_t VoVol = 0;
-		uint16_t fnum = 0;
-		uint16_t block = 0;
-
-		fvelocity  = ((float)(vv & 0x7F))/127.0F;
-		fvelocity *= ((float)(_play_tuning[ch].Expression & 0x7F)) / 127.0F;
-
-		ChVol = (uint8_t)( 31.0F * fvelocity );
-		VoVol = (uint8_t)( 31.0F * (float)(_play_tuning[ch].ChannelVolume & 0x7F) / 127.0F);
+		YMF825_VoiceFrame_t frame;
 
 		// note on
-		YMF825_SelectChannel(ch);
-		YMF825_ChangeVoVol(VoVol);
-		YMF825_ChangeChVol(ChVol);
-
-		fnum = _note_tbl[kk & 0x7F].FNUM;
-		block = _note_tbl[kk & 0x7F].BLOCK;
-
-		YMF825_SelectNoteNumber(fnum, block);
-		YMF825_KeyOn(tone_num);
+		frame.voice = ch;
+		frame.ChVol = Volume_ApplyYMF825Gain(Volume_ApplyVelocityCurve(vv), _play_tuning[ch].ChVolGain);
+		frame.VoVol = _play_tuning[ch].VoVol;
+		frame.fnum = _note_tbl[kk & 0x7F].FNUM;
+		frame.block = _note_tbl[kk & 0x7F].BLOCK;
+		frame.INT = _play_tuning[ch].INT;
+		frame.FRAC = _play_tuning[ch].FRAC;
+		frame.tone_num = tone_num;
+		YMF825_WriteVoiceFrame(&frame);
 	}
 	else {
 
 		// note off
-		YMF825_SelectChannel(ch);
-		YMF825_KeyOff(tone_num);
+		YMF825_KeyOffVoice(ch, tone_num);
 	}
 }
 
@@ -176,6 +186,7 @@ static void _ymf825_ControlChange(uint8_t ch, uint8_t cc, uint8_t vv) {
 				case 0x0000:// Pitch Bend Sensitibity;
 				{
 					_play_tuning[ch].PitchBendSensitibity = _play_tuning[ch].DAT.MSB;
+					_UpdatePitchCache(ch);
 
 				}
 				break;
@@ -194,17 +205,14 @@ static void _ymf825_ControlChange(uint8_t ch, uint8_t cc, uint8_t vv) {
 
 		case 7:// Channel Volume
 		{
-			float fvelocity = 0.0F;
 			uint8_t ChVol = 0;
 			uint8_t VoVol = 0;
 
 			_play_tuning[ch].ChannelVolume = vv;
+			_UpdateVolumeCache(ch);
 
-			fvelocity  = ((float)(vv & 0x7F))/127.0F;
-			fvelocity *= ((float)(_play_tuning[ch].Expression & 0x7F)) / 127.0F;
-
-			ChVol = (uint8_t)( 31.0F * fvelocity );
-			VoVol = (uint8_t)( 31.0F * (float)(_play_tuning[ch].ChannelVolume & 0x7F) / 127.0F);
+			ChVol = Volume_ApplyYMF825Gain(vv, _play_tuning[ch].ChVolGain);
+			VoVol = _play_tuning[ch].VoVol;
 
 			// note on
 			YMF825_SelectChannel(ch);
@@ -215,16 +223,13 @@ static void _ymf825_ControlChange(uint8_t ch, uint8_t cc, uint8_t vv) {
 
 		case 11:// Expression
 		{
-			float fvelocity = 0.0F;
 			uint8_t ChVol = 0;
 			uint8_t VoVol = 0;
 			_play_tuning[ch].Expression = vv;
+			_UpdateVolumeCache(ch);
 
-			fvelocity  = ((float)(vv & 0x7F))/127.0F;
-			fvelocity *= ((float)(_play_tuning[ch].Expression & 0x7F)) / 127.0F;
-
-			ChVol = (uint8_t)( 31.0F * fvelocity );
-			VoVol = (uint8_t)( 31.0F * (float)(_play_tuning[ch].ChannelVolume & 0x7F) / 127.0F);
+			ChVol = Volume_ApplyYMF825Gain(vv, _play_tuning[ch].ChVolGain);
+			VoVol = _play_tuning[ch].VoVol;
 
 			// note on
 			YMF825_SelectChannel(ch);
@@ -243,6 +248,7 @@ static void _ymf825_ControlChange(uint8_t ch, uint8_t cc, uint8_t vv) {
 				case 0x0000:// Pitch Bend Sensitibity;
 				{
 					_play_tuning[ch].PitchBendSensitibity = _play_tuning[ch].DAT.MSB;
+					_UpdatePitchCache(ch);
 				}
 				break;
 
@@ -290,8 +296,7 @@ static void _ymf825_ControlChange(uint8_t ch, uint8_t cc, uint8_t vv) {
 			uint8_t tone_num = 0;
 			tone_num = ch;
 			// note off
-			YMF825_SelectChannel(ch);
-			YMF825_KeyOff(tone_num);
+			YMF825_KeyOffVoice(ch, tone_num);
 		}
 		break;
 
@@ -305,8 +310,8 @@ static void _ymf825_ProgramChange(uint8_t ch, uint8_t pp) {
 
 	// TODO control change
 	if ( ch != 9 ) {
-		memcpy(_ch_program_tbl[(ch&0x0F)], ymf825_tone_table[(pp&0x7F)], 30);
-		YMF825_SetToneParameter(_ch_program_tbl);	
+		_SetProgram(ch, ymf825_tone_table[(pp&0x7F)], pp&0x7F);
+		_UploadDirtyTones();
 	}
 }
 
@@ -314,21 +319,11 @@ static void _ymf825_PitchBendChange(uint8_t ch, uint8_t ll, uint8_t hh) {
 
 	uint16_t INT  = 0;
 	uint16_t FRAC = 0;
-	uint16_t shift = 0;
-	uint16_t pitch = 0;
-	float fratio = 0.0F;
-
-	shift = (hh << 7) | ll;
-	fratio = (float)pow(2.0, (double)_play_tuning[ch].PitchBendSensitibity / 12.0 * (double)(shift-8192) / 8192.0);
 
-	pitch = (uint16_t)(512.0F * fratio);
-
-	if ( pitch >= 2048) {
-		pitch = 2047;
-	}
-
-	INT = (pitch >> 9) & 0x03; 
-	FRAC = pitch & 0x1FF;
+	_play_tuning[ch].PitchBend = (hh << 7) | ll;
+	_UpdatePitchCache(ch);
+	INT = _play_tuning[ch].INT;
+	FRAC = _play_tuning[ch].FRAC;
 		
 	YMF825_SelectChannel(ch);
 	YMF825_ChangePitch(INT, FRAC);
@@ -343,10 +338,10 @@ static void _ResetChannelSetting(uint8_t ch) {
 
 		// reset program change
 		if ( ch == 9 ) {
-			memcpy(_ch_program_tbl[ch], _tone_noise, NUM_OF_TONE_CFG);
+			_SetProgram(ch, _tone_noise, PROGRAM_NO_NOT_GM);
 		}
 		else {
-			memcpy(_ch_program_tbl[ch], ymf825_tone_table[0], NUM_OF_TONE_CFG);
+			_SetProgram(ch, ymf825_tone_table[0], 0);
 		}
 
 		// RPN
@@ -357,9 +352,65 @@ static void _ResetChannelSetting(uint8_t ch) {
 		_play_tuning[ch].PitchBendSensitibity = 2;
 		_play_tuning[ch].Expression = 0x7F;
 		_play_tuning[ch].ChannelVolume = 64;
+		_play_tuning[ch].PitchBend = 8192;
+		_UpdateVolumeCache(ch);
+		_UpdatePitchCache(ch);
 
 		YMF825_ChangeVoVol(0);
 		YMF825_ChangeChVol(0);
 		YMF825_ChangePitch(1, 0);
 	}
 }
+
+// tone number is equal to the channel number, so the uploaded bank replaces the programs of all channels.
+static void _ApplyToneBank(uint8_t bank[YMF825_TONE_BANK_SLOT_NUM][YMF825_TONE_BANK_BLOCK_SIZE]) {
+
+	uint8_t i = 0;
+
+	for ( i = 0; i < MAX_TONE_NUMBER; i++ ) {
+		memcpy(_ch_program_tbl[i], bank[i], NUM_OF_TONE_CFG);
+		_ch_program_no[i] = PROGRAM_NO_NOT_GM;
+	}
+	_dirty_tone_mask = 0xFFFF;
+	_UploadDirtyTones();
+}
+
+static void _SetProgram(uint8_t ch, const uint8_t *tone, uint8_t program_no) {
+
+	if ( ( _ch_program_no[ch] == program_no ) && ( program_no != PROGRAM_NO_NOT_GM ) ) {
+		// already in the table.
+		return;
+	}
+	memcpy(_ch_program_tbl[ch], tone, NUM_OF_TONE_CFG);
+	_ch_program_no[ch] = program_no;
+	_dirty_tone_mask |= (1U << ch);
+}
+
+// the chip takes the tones from #0 up to the given number,
+// so the upload is cut after the last dirty slot. the pending uploads are merged by the driver.
+static void _UploadDirtyTones(void) {
+
+	uint8_t block_num = MAX_TONE_NUMBER;
+
+	if ( _dirty_tone_mask == 0 ) {
+		return;
+	}
+	while ( ( _dirty_tone_mask & (1U << (block_num - 1)) ) == 0 ) {
+		block_num--;
+	}
+	YMF825_RequestToneParameter(_ch_program_tbl, block_num);
+	_dirty_tone_mask = 0;
+}
+
+static void _UpdateVolumeCache(uint8_t ch) {
+
+	_play_tuning[ch].VoVol = Volume_GetYMF825Level(_play_tuning[ch].ChannelVolume);
+	_play_tuning[ch].ChVolGain = Volume_GetYMF825Gain(_play_tuning[ch].Expression);
+}
+
+static void _UpdatePitchCache(uint8_t ch) {
+
+	PitchBend_ToYMF825(
+		PitchBend_GetFreqRatio(_play_tuning[ch].PitchBendSensitibity, _play_tuning[ch].PitchBend),
+		&_play_tuning[ch].INT, &_play_tuning[ch].FRAC);
+}
\ No newline at end of file
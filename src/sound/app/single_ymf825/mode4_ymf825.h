@@ -26,7 +26,7 @@
 
 #include "midi.h"
 
-extern MIDI_Handle_t *MIDI_Mode4_YMF825_Init(void);
-extern void MIDI_Mode4_YMF825_DeInit(MIDI_Handle_t *phMIDI);
+extern const MIDI_Message_Callbacks_t *MIDI_Mode4_YMF825_Init(void);
+extern void MIDI_Mode4_YMF825_DeInit(void);
 
 #endif /* __MODE4_YMF825_H__ */
\ No newline at end of file
@@ -24,18 +24,15 @@
 #include "music_box_ymf825.h"
 #include "ymf825.h"
 #include "ymf825_note_table.h"
+#include "pitch_bend.h"
+#include "volume.h"
+#include "voice_alloc.h"
 #include <string.h> // memcpy
-#include <math.h> // pow
 #include "midi_cdc_core.h"
 
 extern const uint8_t ymf825_tone_table[128][30];
 
 
-#define YMF825_NOTE_OFF         0 
-#define YMF825_NOTE_ON          1
-
-#define MAX_RELEASE_COUNTDOWN	15
-
 #define MAX_TONE_NUMBER		2
 #define MAX_CH_NUMBER		16
 #define NUM_OF_TONE_CFG		30
@@ -57,20 +54,19 @@ typedef struct _MIDI_PlayTuning {
 	uint8_t PitchBendSensitibity;
 	uint8_t ChannelVolume;
 	uint8_t Expression;
+	uint16_t PitchBend;
+	// derived values, updated only when the parameters above change.
+	uint8_t VoVol;			// of ChannelVolume
+	uint16_t ChVolGain;		// of Expression (Volume_GetYMF825Gain)
+	uint16_t INT;			// pitch of PitchBend and PitchBendSensitibity
+	uint16_t FRAC;
 }MIDI_PlayTuning_t;
-
-typedef struct 
-{
-	uint8_t key_stat; // current key state (on/off)
-	uint8_t note_no;  // note number
-	uint8_t mid_ch;   // midi channel
-	uint8_t release_cnt; // release cowntdown
-} ymf825_ch_stat_t;
 #pragma pack()
 
 static music_box_ymf825_config_t _music_box_ymf825_config = {
 	.percussion_msg = MUSIC_BOX_YMF825_IGNORE_PERCUSSION_MESSAGE,
-	.program_no = 11
+	.program_no = 11,
+	.voice_steal = VOICE_ALLOC_STEAL_OLDEST
 };
 
 static const uint8_t _tone_noise[NUM_OF_TONE_CFG] ={
@@ -83,27 +79,12 @@ static const uint8_t _tone_noise[NUM_OF_TONE_CFG] ={
 
 static MIDI_PlayTuning_t _play_tuning[MAX_CH_NUMBER];
 static uint8_t _ch_program_tbl[MAX_TONE_NUMBER][NUM_OF_TONE_CFG];
-static ymf825_ch_stat_t _ch_stat[MAX_CH_NUMBER] = 
-{
-	{YMF825_NOTE_OFF, 0, 0, 0},
-	{YMF825_NOTE_OFF, 0, 0, 0},
-	{YMF825_NOTE_OFF, 0, 0, 0}, 
-	{YMF825_NOTE_OFF, 0, 0, 0}, 
-	{YMF825_NOTE_OFF, 0, 0, 0}, 
-	{YMF825_NOTE_OFF, 0, 0, 0}, 
-	{YMF825_NOTE_OFF, 0, 0, 0}, 
-	{YMF825_NOTE_OFF, 0, 0, 0}, 
-	{YMF825_NOTE_OFF, 0, 0, 0}, 
-	{YMF825_NOTE_OFF, 0, 0, 0}, 
-	{YMF825_NOTE_OFF, 0, 0, 0}, 
-	{YMF825_NOTE_OFF, 0, 0, 0}, 
-	{YMF825_NOTE_OFF, 0, 0, 0}, 
-	{YMF825_NOTE_OFF, 0, 0, 0}, 
-	{YMF825_NOTE_OFF, 0, 0, 0}, 
-	{YMF825_NOTE_OFF, 0, 0, 0}, 
-};
+static VoiceAlloc_t _voice_alloc;
+static uint8_t _voice_tone[MAX_CH_NUMBER]; // the tone keyed on at each voice, to key off a stolen voice
 
 static void _ResetChannelSetting(uint8_t ch);
+static void _UpdateVolumeCache(uint8_t ch);
+static void _UpdatePitchCache(uint8_t ch);
 static void _ChannelKeyOff(uint8_t ch);
 static void _ChannelVolumeChange(uint8_t ch, uint8_t ChVol, uint8_t VoVol);
 
@@ -138,13 +119,14 @@ static const MIDI_Message_Callbacks_t _ymf825_midi_msg_callbacks = {
 	}
 };
 
-MIDI_Handle_t *MIDI_MUSIC_BOX_YMF825_Init(void) {
+const MIDI_Message_Callbacks_t *MIDI_MUSIC_BOX_YMF825_Init(void) {
 
 	uint8_t i = 0;
 	uint32_t set_conf_result = -1;
-	MIDI_Handle_t *phMIDI = NULL;
+	const MIDI_Message_Callbacks_t *pcallbacks = NULL;
 
 	YMF825_Init();
+	VoiceAlloc_Init(&_voice_alloc, MAX_CH_NUMBER, _music_box_ymf825_config.voice_steal);
 
 	for ( i = 0; i < 16; i++ ) {
 		_ResetChannelSetting(i);
@@ -153,15 +135,14 @@ MIDI_Handle_t *MIDI_MUSIC_BOX_YMF825_Init(void) {
 	set_conf_result = SetConfig_MUSIC_BOX_YMF825(&_music_box_ymf825_config);
 	if ( set_conf_result == 0 )
 	{
-		phMIDI = MIDI_Init(&_ymf825_midi_msg_callbacks);
+		pcallbacks = &_ymf825_midi_msg_callbacks;
 	}
 
-	return phMIDI;
+	return pcallbacks;
 }
 
-void MIDI_MUSIC_BOX_YMF825_DeInit(MIDI_Handle_t *phMIDI) {
-
-	MIDI_DeInit(phMIDI);
+void MIDI_MUSIC_BOX_YMF825_DeInit(void) {
+	// nothing to release.
 }
 
 int32_t SetConfig_MUSIC_BOX_YMF825(const music_box_ymf825_config_t *cfg)
@@ -174,14 +155,24 @@ int32_t SetConfig_MUSIC_BOX_YMF825(const music_box_ymf825_config_t *cfg)
 	{
 		return -2;
 	}
+	else if ( NUM_OF_VOICE_ALLOC_STEAL <= cfg->voice_steal )
+	{
+		return -3;
+	}
 	else
 	{
 		memcpy(_ch_program_tbl[YMF825_TONE_NUM_NOISE],	 _tone_noise, NUM_OF_TONE_CFG);
 		memcpy(_ch_program_tbl[YMF825_TONE_NUM_TONE], 	ymf825_tone_table[cfg->program_no-1], NUM_OF_TONE_CFG);
 		YMF825_SetToneParameterEx(_ch_program_tbl, MAX_TONE_NUMBER);	
 
+		if ( cfg->percussion_msg == MUSIC_BOX_YMF825_IGNORE_PERCUSSION_MESSAGE )
+		{// messages of the percussion channel are no longer received, release its notes now.
+			_ChannelKeyOff(PERCUSSION_CHANNEL_NO);
+		}
 		_music_box_ymf825_config.percussion_msg = cfg->percussion_msg;
 		_music_box_ymf825_config.program_no 	= cfg->program_no;
+		_music_box_ymf825_config.voice_steal	= cfg->voice_steal;
+		VoiceAlloc_SetSteal(&_voice_alloc, cfg->voice_steal);
 		return 0;
 	}
 }
@@ -194,41 +185,32 @@ int32_t GetConfig_MUSIC_BOX_YMF825(music_box_ymf825_config_t *out)
 	}
 	out->percussion_msg = _music_box_ymf825_config.percussion_msg;
 	out->program_no 	= _music_box_ymf825_config.program_no;
+	out->voice_steal	= _music_box_ymf825_config.voice_steal;
 	return 0;
 }
 
+uint16_t GetChMask_MUSIC_BOX_YMF825(void)
+{
+	if ( _music_box_ymf825_config.percussion_msg == MUSIC_BOX_YMF825_IGNORE_PERCUSSION_MESSAGE )
+	{
+		return MIDI_CH_MASK_ALL & ~(1U << PERCUSSION_CHANNEL_NO);
+	}
+	return MIDI_CH_MASK_ALL;
+}
+
 static void _ymf825_NoteOff(uint8_t ch, uint8_t kk, uint8_t uu) {
 	
-	uint32_t i = 0;
+	uint8_t voice = VOICE_ALLOC_NONE;
 	(void)uu;
 
-	for ( i = 0; i < MAX_CH_NUMBER; i++ )
+	voice = VoiceAlloc_NoteOff(&_voice_alloc, ch, kk);
+	if ( voice != VOICE_ALLOC_NONE )
 	{
-		if (( _ch_stat[i].key_stat == YMF825_NOTE_OFF )
-		&&  ( _ch_stat[i].release_cnt != 0 ))
-		{
-			_ch_stat[i].release_cnt--;
-		}
-	}
-
-	for ( i = 0; i < MAX_CH_NUMBER; i++ )
-	{
-		if (( _ch_stat[i].key_stat  == YMF825_NOTE_ON )
-		&&  ( _ch_stat[i].note_no  == kk )
-		&&  ( _ch_stat[i].mid_ch == ch ))
-		{
-			// note off
-			YMF825_SelectChannel(i);
-			YMF825_KeyOff(YMF825_TONE_NUM_TONE);
+		// note off
+		YMF825_KeyOffVoice(voice, _voice_tone[voice]);
 
-			// Reset PitchBend
-			YMF825_ChangePitch(1, 0);
-
-			// update a channel status.
-			_ch_stat[i].key_stat = YMF825_NOTE_OFF;
-			_ch_stat[i].release_cnt = MAX_RELEASE_COUNTDOWN;
-			break;
-		}
+		// Reset PitchBend
+		YMF825_ChangePitch(1, 0);
 	}
 }
 
@@ -236,74 +218,40 @@ static void _ymf825_NoteOn(uint8_t ch, uint8_t kk, uint8_t vv) {
 
 	if (vv != 0x00 ) {
 		uint8_t tone_num = 0;
-		ymf825_ch_stat_t *p_tentative = (ymf825_ch_stat_t *)0; 
-		uint8_t next_note_on_ch = 0;
-		uint32_t i = 0;
-		float fvelocity = 0.0F;
-		uint8_t ChVol = 0;
-		uint8_t VoVol = 0;
-		uint16_t fnum = 0;
-		uint16_t block = 0;
+		uint8_t voice = VOICE_ALLOC_NONE;
+		uint8_t off_voice = VOICE_ALLOC_NONE;
+		YMF825_VoiceFrame_t frame;
 
+		// messages of the percussion channel are filtered out by the parser when ignored (see GetChMask_MUSIC_BOX_YMF825).
 		if ( ch == PERCUSSION_CHANNEL_NO )
 		{
-			if ( _music_box_ymf825_config.percussion_msg == MUSIC_BOX_YMF825_ACCEPT_PERCUSSION_MESSAGE )
-			{
-				tone_num = YMF825_TONE_NUM_NOISE;
-			}
-			else
-			{// Ignore message of percussion channel.
-				return;
-			}
+			tone_num = YMF825_TONE_NUM_NOISE;
 		}
 		else
 		{
 			tone_num = YMF825_TONE_NUM_TONE;
 		}
 
-		for ( i = 0; i < MAX_CH_NUMBER; i++ )
-		{
-			if ( _ch_stat[i].key_stat == YMF825_NOTE_OFF )
-			{
-				if ( p_tentative == (ymf825_ch_stat_t *) 0)
-				{
-					p_tentative = &_ch_stat[i];
-					next_note_on_ch = i;
-				}
-				else
-				{
-					if ( p_tentative->release_cnt > _ch_stat[i].release_cnt )
-					{
-						p_tentative = &_ch_stat[i];
-						next_note_on_ch = i;
-					}
-				}
-			}
-		}
-
-		if ( p_tentative )
-		{// note on
+		frame.ChVol = Volume_ApplyYMF825Gain(Volume_ApplyVelocityCurve(vv), _play_tuning[ch].ChVolGain);
 
-			fvelocity  = ((float)(vv & 0x7F))/127.0F;
-			fvelocity *= ((float)(_play_tuning[ch].Expression & 0x7F)) / 127.0F;
-
-			ChVol = (uint8_t)( 31.0F * fvelocity );
-			VoVol = (uint8_t)( 31.0F * (float)(_play_tuning[ch].ChannelVolume & 0x7F) / 127.0F);
-
-			fnum = _note_tbl[kk & 0x7F].FNUM;
-			block = _note_tbl[kk & 0x7F].BLOCK;
+		voice = VoiceAlloc_NoteOn(&_voice_alloc, ch, kk & 0x7F, frame.ChVol, &off_voice);
+		if ( off_voice != VOICE_ALLOC_NONE )
+		{// stolen, or the same key retriggered.
+			YMF825_KeyOffVoice(off_voice, _voice_tone[off_voice]);
+		}
 
+		if ( voice != VOICE_ALLOC_NONE )
+		{
 			// note on
-			YMF825_SelectChannel(next_note_on_ch);
-			YMF825_ChangeVoVol(VoVol);
-			YMF825_ChangeChVol(ChVol);
-			YMF825_SelectNoteNumber(fnum, block);
-			YMF825_KeyOn(tone_num);
-
-			// update a channel status.
-			p_tentative->key_stat = YMF825_NOTE_ON;
-			p_tentative->note_no = kk;
-			p_tentative->mid_ch = ch;
+			frame.voice = voice;
+			frame.VoVol = _play_tuning[ch].VoVol;
+			frame.fnum = _note_tbl[kk & 0x7F].FNUM;
+			frame.block = _note_tbl[kk & 0x7F].BLOCK;
+			frame.INT = _play_tuning[ch].INT;
+			frame.FRAC = _play_tuning[ch].FRAC;
+			frame.tone_num = tone_num;
+			YMF825_WriteVoiceFrame(&frame);
+			_voice_tone[voice] = tone_num;
 		}
 	}
 	else {
@@ -326,6 +274,7 @@ static void _ymf825_ControlChange(uint8_t ch, uint8_t cc, uint8_t vv) {
 				case 0x0000:// Pitch Bend Sensitibity;
 				{
 					_play_tuning[ch].PitchBendSensitibity = _play_tuning[ch].DAT.MSB;
+					_UpdatePitchCache(ch);
 
 				}
 				break;
@@ -344,17 +293,14 @@ static void _ymf825_ControlChange(uint8_t ch, uint8_t cc, uint8_t vv) {
 
 		case 7:// Channel Volume
 		{
-			float fvelocity = 0.0F;
 			uint8_t ChVol = 0;
 			uint8_t VoVol = 0;
 
 			_play_tuning[ch].ChannelVolume = vv;
+			_UpdateVolumeCache(ch);
 
-			fvelocity  = ((float)(vv & 0x7F))/127.0F;
-			fvelocity *= ((float)(_play_tuning[ch].Expression & 0x7F)) / 127.0F;
-
-			ChVol = (uint8_t)( 31.0F * fvelocity );
-			VoVol = (uint8_t)( 31.0F * (float)(_play_tuning[ch].ChannelVolume & 0x7F) / 127.0F);
+			ChVol = Volume_ApplyYMF825Gain(vv, _play_tuning[ch].ChVolGain);
+			VoVol = _play_tuning[ch].VoVol;
 
 			_ChannelVolumeChange(ch, ChVol, VoVol);
 		}
@@ -362,16 +308,13 @@ static void _ymf825_ControlChange(uint8_t ch, uint8_t cc, uint8_t vv) {
 
 		case 11:// Expression
 		{
-			float fvelocity = 0.0F;
 			uint8_t ChVol = 0;
 			uint8_t VoVol = 0;
 			_play_tuning[ch].Expression = vv;
+			_UpdateVolumeCache(ch);
 
-			fvelocity  = ((float)(vv & 0x7F))/127.0F;
-			fvelocity *= ((float)(_play_tuning[ch].Expression & 0x7F)) / 127.0F;
-
-			ChVol = (uint8_t)( 31.0F * fvelocity );
-			VoVol = (uint8_t)( 31.0F * (float)(_play_tuning[ch].ChannelVolume & 0x7F) / 127.0F);
+			ChVol = Volume_ApplyYMF825Gain(vv, _play_tuning[ch].ChVolGain);
+			VoVol = _play_tuning[ch].VoVol;
 
 			_ChannelVolumeChange(ch, ChVol, VoVol);
 
@@ -388,6 +331,7 @@ static void _ymf825_ControlChange(uint8_t ch, uint8_t cc, uint8_t vv) {
 				case 0x0000:// Pitch Bend Sensitibity;
 				{
 					_play_tuning[ch].PitchBendSensitibity = _play_tuning[ch].DAT.MSB;
+					_UpdatePitchCache(ch);
 				}
 				break;
 
@@ -442,28 +386,17 @@ static void _ymf825_PitchBendChange(uint8_t ch, uint8_t ll, uint8_t hh) {
 
 	uint16_t INT  = 0;
 	uint16_t FRAC = 0;
-	uint16_t shift = 0;
-	uint16_t pitch = 0;
-	float fratio = 0.0F;
-
-	shift = (hh << 7) | ll;
-	fratio = (float)pow(2.0, (double)_play_tuning[ch].PitchBendSensitibity / 12.0 * (double)(shift-8192) / 8192.0);
-
-	pitch = (uint16_t)(512.0F * fratio);
 
-	if ( pitch >= 2048) {
-		pitch = 2047;
-	}
-
-	INT = (pitch >> 9) & 0x03; 
-	FRAC = pitch & 0x1FF;
+	_play_tuning[ch].PitchBend = (hh << 7) | ll;
+	_UpdatePitchCache(ch);
+	INT = _play_tuning[ch].INT;
+	FRAC = _play_tuning[ch].FRAC;
 		
-	for (int i = 0; i < MAX_CH_NUMBER; i++ )
+	for ( uint8_t v = VoiceAlloc_FirstActive(&_voice_alloc); v != VOICE_ALLOC_NONE; v = VoiceAlloc_NextActive(&_voice_alloc, v) )
 	{
-		if (( _ch_stat[i].mid_ch == ch )
-		&&  ( _ch_stat[i].key_stat == YMF825_NOTE_ON))
+		if ( _voice_alloc.voice[v].ch == ch )
 		{
-			YMF825_SelectChannel(i);
+			YMF825_SelectChannel(v);
 			YMF825_ChangePitch(INT, FRAC);
 		}
 	}
@@ -484,6 +417,9 @@ static void _ResetChannelSetting(uint8_t ch) {
 		_play_tuning[ch].PitchBendSensitibity = 2;
 		_play_tuning[ch].Expression = 0x7F;
 		_play_tuning[ch].ChannelVolume = 64;
+		_play_tuning[ch].PitchBend = 8192;
+		_UpdateVolumeCache(ch);
+		_UpdatePitchCache(ch);
 
 		YMF825_ChangeVoVol(0);
 		YMF825_ChangeChVol(0);
@@ -497,29 +433,44 @@ static void _ChannelKeyOff(uint8_t ch)
 	uint8_t tone_num = 0;
 	tone_num = (ch == PERCUSSION_CHANNEL_NO) ? YMF825_TONE_NUM_NOISE : YMF825_TONE_NUM_TONE;
 
-	for (uint32_t i = 0; i < MAX_CH_NUMBER; i++ )
+	uint8_t v = VoiceAlloc_FirstActive(&_voice_alloc);
+	uint8_t next = VOICE_ALLOC_NONE;
+
+	while ( v != VOICE_ALLOC_NONE )
 	{
-		if (( _ch_stat[i].mid_ch == ch )
-		&&  ( _ch_stat[i].key_stat == YMF825_NOTE_ON))
+		next = VoiceAlloc_NextActive(&_voice_alloc, v);
+		if ( _voice_alloc.voice[v].ch == ch )
 		{
-			YMF825_SelectChannel(i);
+			YMF825_SelectChannel(v);
 			YMF825_KeyOff(tone_num);
-			_ch_stat[i].key_stat = YMF825_NOTE_OFF;
-			_ch_stat[i].release_cnt = 0;
+			VoiceAlloc_Release(&_voice_alloc, v);
 		}
+		v = next;
 	}
 }
 
 static void _ChannelVolumeChange(uint8_t ch, uint8_t ChVol, uint8_t VoVol)
 {
-	for (uint32_t i = 0; i < MAX_CH_NUMBER; i++ )
+	for ( uint8_t v = VoiceAlloc_FirstActive(&_voice_alloc); v != VOICE_ALLOC_NONE; v = VoiceAlloc_NextActive(&_voice_alloc, v) )
 	{
-		if (( _ch_stat[i].mid_ch == ch )
-		&&  ( _ch_stat[i].key_stat == YMF825_NOTE_ON))
+		if ( _voice_alloc.voice[v].ch == ch )
 		{
-			YMF825_SelectChannel(i);
+			YMF825_SelectChannel(v);
 			YMF825_ChangeVoVol(VoVol);
 			YMF825_ChangeChVol(ChVol);
 		}
 	}
+}
+
+static void _UpdateVolumeCache(uint8_t ch) {
+
+	_play_tuning[ch].VoVol = Volume_GetYMF825Level(_play_tuning[ch].ChannelVolume);
+	_play_tuning[ch].ChVolGain = Volume_GetYMF825Gain(_play_tuning[ch].Expression);
+}
+
+static void _UpdatePitchCache(uint8_t ch) {
+
+	PitchBend_ToYMF825(
+		PitchBend_GetFreqRatio(_play_tuning[ch].PitchBendSensitibity, _play_tuning[ch].PitchBend),
+		&_play_tuning[ch].INT, &_play_tuning[ch].FRAC);
 }
\ No newline at end of file
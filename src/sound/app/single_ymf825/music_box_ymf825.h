@@ -25,6 +25,7 @@
 #define __MUSIC_BOX_YMF825_H__
 
 #include "midi.h"
+#include "voice_alloc.h"
 
 #define MUSIC_BOX_YMF825_IGNORE_PERCUSSION_MESSAGE  0
 #define MUSIC_BOX_YMF825_ACCEPT_PERCUSSION_MESSAGE  1
@@ -34,12 +35,14 @@ typedef struct
 {
   uint8_t percussion_msg; // accept or ignore
   uint8_t program_no;     // Program number to use. The range is [1-128].
+  uint8_t voice_steal;    // VoiceAlloc_Steal_t. The voice to be stolen when all voices are busy.
 } music_box_ymf825_config_t;
 #pragma pack()
 
-extern MIDI_Handle_t *MIDI_MUSIC_BOX_YMF825_Init(void);
-extern void MIDI_MUSIC_BOX_YMF825_DeInit(MIDI_Handle_t *phMIDI);
+extern const MIDI_Message_Callbacks_t *MIDI_MUSIC_BOX_YMF825_Init(void);
+extern void MIDI_MUSIC_BOX_YMF825_DeInit(void);
 extern int32_t SetConfig_MUSIC_BOX_YMF825(const music_box_ymf825_config_t *cfg);
 extern int32_t GetConfig_MUSIC_BOX_YMF825(music_box_ymf825_config_t *out);
+extern uint16_t GetChMask_MUSIC_BOX_YMF825(void);
 
 #endif /* __MUSIC_BOX_YMF825_H__ */
\ No newline at end of file
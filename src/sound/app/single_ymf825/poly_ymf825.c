@@ -0,0 +1,556 @@
+/*
+  MIT License
+
+  Copyright (c) 2020 nyannkov
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+#include "poly_ymf825.h"
+#include "ymf825.h"
+#include "ymf825_note_table.h"
+#include "ymf825_tone_bank.h"
+#include "pitch_bend.h"
+#include "volume.h"
+#include "voice_alloc.h"
+#include <string.h> // memcpy, memset
+
+extern const uint8_t ymf825_tone_table[128][30];
+
+
+#define MAX_TONE_NUMBER		16
+#define MAX_CH_NUMBER		16
+// the voices of all chips. the voice v is the voice v / YMF825_DEVICE_NUM of the chip v % YMF825_DEVICE_NUM,
+// so that the free voices, taken in order, spread the notes over the chips.
+#define MAX_VOICE_NUMBER	(16 * YMF825_DEVICE_NUM)
+#if VOICE_ALLOC_MAX_VOICE < MAX_VOICE_NUMBER
+#error "VOICE_ALLOC_MAX_VOICE is less than the voices of the chips."
+#endif
+#define NUM_OF_TONE_CFG		30
+
+#define PERCUSSION_CHANNEL_NO	9
+
+// programs held by the tone slots. 0-127: GM, then the noise and the slots of an uploaded tone bank.
+#define PROGRAM_NOISE		128
+#define PROGRAM_BANK(n)		(129 + (n))
+#define NUM_OF_PROGRAM		PROGRAM_BANK(MAX_TONE_NUMBER)
+#define PROGRAM_NONE		0xFF
+#define TONE_SLOT_NONE		0xFF
+
+typedef struct _MIDI_TuningData {
+	uint8_t LSB;
+	uint8_t MSB;
+}MIDI_TuningData_t;
+
+
+typedef struct _MIDI_PlayTuning {
+	MIDI_TuningData_t RPN;
+	MIDI_TuningData_t DAT;
+	uint8_t PitchBendSensitibity;
+	uint8_t ChannelVolume;
+	uint8_t Expression;
+	uint16_t PitchBend;
+	// derived values, updated only when the parameters above change.
+	uint8_t VoVol;			// of ChannelVolume
+	uint16_t ChVolGain;		// of Expression (Volume_GetYMF825Gain)
+	uint16_t INT;			// pitch of PitchBend and PitchBendSensitibity
+	uint16_t FRAC;
+}MIDI_PlayTuning_t;
+
+typedef struct
+{
+	uint8_t program;	// PROGRAM_NONE: empty
+	uint8_t ref;		// channels whose current program is in the slot
+	uint32_t last_use;	// for the LRU
+} poly_tone_slot_t;
+
+
+static uint8_t _tone_tbl[MAX_TONE_NUMBER][NUM_OF_TONE_CFG];
+static poly_tone_slot_t _tone_slot[MAX_TONE_NUMBER];
+static uint8_t _program_slot[NUM_OF_PROGRAM];
+static uint8_t _ch_program[MAX_CH_NUMBER];
+static uint8_t _voice_tone[MAX_VOICE_NUMBER];
+static uint8_t _voice_velocity[MAX_VOICE_NUMBER]; // through the velocity curve
+static uint32_t _use_clock;
+// slots of _tone_tbl which differ from the tone memory of the chip.
+static uint16_t _dirty_tone_mask;
+static VoiceAlloc_t _voice_alloc;
+static const uint8_t _tone_noise[NUM_OF_TONE_CFG] ={
+  0x01,0x80,
+  0x00,0x0F,0xF0,0x00,0x00,0x10,0x07,
+  0x40,0xDF,0xF0,0x1C,0x00,0x00,0x00,
+  0x00,0x2F,0xF3,0x9B,0x00,0x20,0x41,
+  0x00,0xAF,0xA0,0x0E,0x10,0x10,0x40,
+};
+
+static MIDI_PlayTuning_t _play_tuning[MAX_CH_NUMBER];
+
+static poly_ymf825_config_t _poly_ymf825_config = {
+	.voice_steal = VOICE_ALLOC_STEAL_OLDEST
+};
+
+static void _ResetChannelSetting(uint8_t ch);
+static void _UpdateVolumeCache(uint8_t ch);
+static void _UpdatePitchCache(uint8_t ch);
+static uint8_t _SelectVoice(uint8_t voice);
+static void _SetProgram(uint8_t ch, uint8_t program);
+static uint8_t _FindFreeToneSlot(void);
+static void _KeyOffTone(uint8_t tone_num);
+static void _KeyOffChannel(uint8_t ch);
+static void _UploadDirtyTones(void);
+static void _ApplyToneBank(uint8_t bank[YMF825_TONE_BANK_SLOT_NUM][YMF825_TONE_BANK_BLOCK_SIZE]);
+
+static void _ymf825_NoteOff(uint8_t ch, uint8_t kk, uint8_t uu);
+static void _ymf825_NoteOn(uint8_t ch, uint8_t kk, uint8_t vv);
+//static void _ymf825_PolyphonicKeyPressure(uint8_t ch, uint8_t kk, uint8_t vv);
+static void _ymf825_ControlChange(uint8_t ch, uint8_t cc, uint8_t vv);
+static void _ymf825_ProgramChange(uint8_t ch, uint8_t pp);
+//static void _ymf825_ChannelPressure(uint8_t ch, uint8_t vv);
+static void _ymf825_PitchBendChange(uint8_t ch, uint8_t ll, uint8_t hh);
+
+static const MIDI_Message_Callbacks_t _ymf825_midi_msg_callbacks = {
+	// MIDI_ChannelMessage_t
+	{
+		// MIDI_ChannelVoiceMessage_t
+		{
+			_ymf825_NoteOff,
+			_ymf825_NoteOn,
+			NULL,
+			_ymf825_ControlChange,
+			_ymf825_ProgramChange,
+			NULL,
+			_ymf825_PitchBendChange
+		}
+	},
+	// MIDI_SystemMessage_t
+	{
+		// MIDI_SystemExclusiveMessage_t
+		{
+			NULL
+		}
+	}
+};
+
+const MIDI_Message_Callbacks_t *MIDI_Poly_YMF825_Init(void) {
+
+	uint8_t i = 0;
+
+	YMF825_Init();
+	VoiceAlloc_Init(&_voice_alloc, MAX_VOICE_NUMBER, _poly_ymf825_config.voice_steal);
+
+	// the tone memory of the chip is unknown.
+	_dirty_tone_mask = 0;
+	_use_clock = 0;
+	memset(_program_slot, TONE_SLOT_NONE, sizeof(_program_slot));
+	for ( i = 0; i < MAX_TONE_NUMBER; i++ ) {
+		_tone_slot[i].program = PROGRAM_NONE;
+		_tone_slot[i].ref = 0;
+		_tone_slot[i].last_use = 0;
+	}
+
+	for ( i = 0; i < MAX_CH_NUMBER; i++ ) {
+		_ch_program[i] = PROGRAM_NONE;
+		_SetProgram(i, (i == PERCUSSION_CHANNEL_NO) ? PROGRAM_NOISE : 0);
+		_ResetChannelSetting(i);
+	}
+	_UploadDirtyTones();
+
+	SetApplyHook_ToneBank_YMF825(_ApplyToneBank);
+
+	return &_ymf825_midi_msg_callbacks;
+}
+
+void MIDI_Poly_YMF825_DeInit(void) {
+
+	SetApplyHook_ToneBank_YMF825(NULL);
+}
+
+int32_t SetConfig_Poly_YMF825(const poly_ymf825_config_t *cfg) {
+
+	if ( cfg == (const poly_ymf825_config_t *)0 ) {
+		return -1;
+	}
+	if ( NUM_OF_VOICE_ALLOC_STEAL <= cfg->voice_steal ) {
+		return -2;
+	}
+	_poly_ymf825_config.voice_steal = cfg->voice_steal;
+	VoiceAlloc_SetSteal(&_voice_alloc, cfg->voice_steal);
+	return 0;
+}
+
+int32_t GetConfig_Poly_YMF825(poly_ymf825_config_t *out) {
+
+	if ( out == (poly_ymf825_config_t *)0 ) {
+		return -1;
+	}
+	out->voice_steal = _poly_ymf825_config.voice_steal;
+	return 0;
+}
+
+static void _ymf825_NoteOff(uint8_t ch, uint8_t kk, uint8_t uu) {
+	
+	uint8_t voice = VOICE_ALLOC_NONE;
+	(void)uu;
+
+	voice = VoiceAlloc_NoteOff(&_voice_alloc, ch, kk);
+	if ( voice != VOICE_ALLOC_NONE ) {
+		// note off
+		YMF825_KeyOffVoice(_SelectVoice(voice), _voice_tone[voice]);
+	}
+}
+
+static void _ymf825_NoteOn(uint8_t ch, uint8_t kk, uint8_t vv) { 
+	
+	if (vv != 0x00 ) {
+		uint8_t tone_num = 0;
+		uint8_t voice = VOICE_ALLOC_NONE;
+		uint8_t off_voice = VOICE_ALLOC_NONE;
+		uint8_t velocity = 0;
+		YMF825_VoiceFrame_t frame;
+
+		// the current program of every channel is held by a slot.
+		tone_num = _program_slot[_ch_program[ch]];
+		_tone_slot[tone_num].last_use = ++_use_clock;
+
+		velocity = Volume_ApplyVelocityCurve(vv);
+		frame.ChVol = Volume_ApplyYMF825Gain(velocity, _play_tuning[ch].ChVolGain);
+
+		voice = VoiceAlloc_NoteOn(&_voice_alloc, ch, kk & 0x7F, frame.ChVol, &off_voice);
+		if ( off_voice != VOICE_ALLOC_NONE ) {
+			// stolen, or the same key retriggered.
+			YMF825_KeyOffVoice(_SelectVoice(off_voice), _voice_tone[off_voice]);
+		}
+
+		if ( voice != VOICE_ALLOC_NONE ) {
+			// note on
+			frame.voice = _SelectVoice(voice);
+			frame.VoVol = _play_tuning[ch].VoVol;
+			frame.fnum = _note_tbl[kk & 0x7F].FNUM;
+			frame.block = _note_tbl[kk & 0x7F].BLOCK;
+			frame.INT = _play_tuning[ch].INT;
+			frame.FRAC = _play_tuning[ch].FRAC;
+			frame.tone_num = tone_num;
+			YMF825_WriteVoiceFrame(&frame);
+			_voice_tone[voice] = tone_num;
+			_voice_velocity[voice] = velocity;
+		}
+	}
+	else {
+
+		_ymf825_NoteOff(ch, kk, vv);
+	}
+}
+
+static void _ymf825_ControlChange(uint8_t ch, uint8_t cc, uint8_t vv) {
+
+	switch (cc) {
+
+		case 6:// Data Entry (MSB)
+		{
+			uint16_t RPN = 0x7F7F;
+			RPN = (_play_tuning[ch].RPN.MSB << 8 ) | (_play_tuning[ch].RPN.LSB); 
+			_play_tuning[ch].DAT.MSB = vv;
+
+			switch (RPN) {
+				case 0x0000:// Pitch Bend Sensitibity;
+				{
+					_play_tuning[ch].PitchBendSensitibity = _play_tuning[ch].DAT.MSB;
+					_UpdatePitchCache(ch);
+				}
+				break;
+
+				case 0x7F7F:// RPN NULL
+				{
+					// NOTHING TO DO
+				}
+				break;
+
+				default:
+				break;
+			}
+		}
+		break;
+
+		case 7:// Channel Volume
+		{
+			_play_tuning[ch].ChannelVolume = vv;
+			_UpdateVolumeCache(ch);
+
+			for ( uint8_t v = VoiceAlloc_FirstActive(&_voice_alloc); v != VOICE_ALLOC_NONE; v = VoiceAlloc_NextActive(&_voice_alloc, v) ) {
+				if ( _voice_alloc.voice[v].ch == ch ) {
+					YMF825_SelectChannel(_SelectVoice(v));
+					YMF825_ChangeVoVol(_play_tuning[ch].VoVol);
+				}
+			}
+		}
+		break;
+
+		case 11:// Expression
+		{
+			_play_tuning[ch].Expression = vv;
+			_UpdateVolumeCache(ch);
+
+			// the velocity of each voice is kept.
+			for ( uint8_t v = VoiceAlloc_FirstActive(&_voice_alloc); v != VOICE_ALLOC_NONE; v = VoiceAlloc_NextActive(&_voice_alloc, v) ) {
+				if ( _voice_alloc.voice[v].ch == ch ) {
+					YMF825_SelectChannel(_SelectVoice(v));
+					YMF825_ChangeChVol(Volume_ApplyYMF825Gain(_voice_velocity[v], _play_tuning[ch].ChVolGain));
+				}
+			}
+		}
+		break;
+
+		case 38:// Data Entry (LSB)
+		{
+			uint16_t RPN = 0x7F7F;
+			RPN = (_play_tuning[ch].RPN.MSB << 8 ) | (_play_tuning[ch].RPN.LSB); 
+			_play_tuning[ch].DAT.LSB = vv;
+
+			switch (RPN) {
+				case 0x0000:// Pitch Bend Sensitibity;
+				{
+					_play_tuning[ch].PitchBendSensitibity = _play_tuning[ch].DAT.MSB;
+					_UpdatePitchCache(ch);
+				}
+				break;
+
+				case 0x7F7F:// RPN NULL
+				{
+					// NOTHING TO DO
+				}
+				break;
+
+				default:
+				break;
+			}
+		}
+		break;
+		case 100:// RPN (LSB)
+		{
+			_play_tuning[ch].RPN.LSB = vv;
+		}
+		break;
+
+		case 101:// RPN (MSB)
+		{
+			_play_tuning[ch].RPN.MSB = vv;
+		}
+		break;
+
+		case 120:// All Sound Off
+		case 123:// All Note Off
+		{
+			_KeyOffChannel(ch);
+		}
+		break;
+
+		case 121:// Reset All Controller
+		{
+			_KeyOffChannel(ch);
+			_ResetChannelSetting(ch);
+		}
+		break;
+
+		default:
+		break;
+	}
+
+}
+
+static void _ymf825_ProgramChange(uint8_t ch, uint8_t pp) {
+
+	if ( ch != PERCUSSION_CHANNEL_NO ) {
+		_SetProgram(ch, pp & 0x7F);
+		_UploadDirtyTones();
+	}
+}
+
+static void _ymf825_PitchBendChange(uint8_t ch, uint8_t ll, uint8_t hh) {
+
+	uint16_t INT  = 0;
+	uint16_t FRAC = 0;
+
+	_play_tuning[ch].PitchBend = (hh << 7) | ll;
+	_UpdatePitchCache(ch);
+	INT = _play_tuning[ch].INT;
+	FRAC = _play_tuning[ch].FRAC;
+
+	for ( uint8_t v = VoiceAlloc_FirstActive(&_voice_alloc); v != VOICE_ALLOC_NONE; v = VoiceAlloc_NextActive(&_voice_alloc, v) ) {
+		if ( _voice_alloc.voice[v].ch == ch ) {
+			YMF825_SelectChannel(_SelectVoice(v));
+			YMF825_ChangePitch(INT, FRAC);
+		}
+	}
+}
+
+static void _ResetChannelSetting(uint8_t ch) {
+
+	if ( ch < 16 ) {
+
+		// RPN
+		_play_tuning[ch].RPN.MSB = 0x7F;
+		_play_tuning[ch].RPN.LSB = 0x7F;
+		_play_tuning[ch].DAT.MSB = 0x00;
+		_play_tuning[ch].DAT.LSB = 0x00;
+		_play_tuning[ch].PitchBendSensitibity = 2;
+		_play_tuning[ch].Expression = 0x7F;
+		_play_tuning[ch].ChannelVolume = 64;
+		_play_tuning[ch].PitchBend = 8192;
+		_UpdateVolumeCache(ch);
+		_UpdatePitchCache(ch);
+	}
+}
+
+// selects the chip of the voice, returns the voice number in the chip.
+static uint8_t _SelectVoice(uint8_t voice) {
+
+	YMF825_SelectDevice(voice % YMF825_DEVICE_NUM);
+	return voice / YMF825_DEVICE_NUM;
+}
+
+// the tone slots are a cache of the programs, the least recently played slot which no channel
+// has as its current program is replaced. only the replaced slots are uploaded.
+static void _SetProgram(uint8_t ch, uint8_t program) {
+
+	uint8_t slot = _program_slot[program];
+
+	if ( _ch_program[ch] == program ) {
+		return;
+	}
+	if ( _ch_program[ch] != PROGRAM_NONE ) {
+		_tone_slot[_program_slot[_ch_program[ch]]].ref--;
+	}
+
+	if ( slot == TONE_SLOT_NONE ) {
+		// 16 channels never hold more than 16 programs, so a free slot is always found.
+		slot = _FindFreeToneSlot();
+		if ( _tone_slot[slot].program != PROGRAM_NONE ) {
+			_program_slot[_tone_slot[slot].program] = TONE_SLOT_NONE;
+			_KeyOffTone(slot);
+		}
+		memcpy(_tone_tbl[slot], (program == PROGRAM_NOISE) ? _tone_noise : ymf825_tone_table[program], NUM_OF_TONE_CFG);
+		_tone_slot[slot].program = program;
+		_program_slot[program] = slot;
+		_dirty_tone_mask |= (1U << slot);
+	}
+
+	_tone_slot[slot].ref++;
+	_tone_slot[slot].last_use = ++_use_clock;
+	_ch_program[ch] = program;
+}
+
+// an empty slot (the lowest first, to keep the upload short), or the least recently used one.
+static uint8_t _FindFreeToneSlot(void) {
+
+	uint8_t slot = TONE_SLOT_NONE;
+	uint8_t i = 0;
+
+	for ( i = 0; i < MAX_TONE_NUMBER; i++ ) {
+		if ( _tone_slot[i].ref != 0 ) {
+			continue;
+		}
+		if ( _tone_slot[i].program == PROGRAM_NONE ) {
+			return i;
+		}
+		if ( ( slot == TONE_SLOT_NONE ) || ( _tone_slot[i].last_use < _tone_slot[slot].last_use ) ) {
+			slot = i;
+		}
+	}
+	return slot;
+}
+
+// release the voices still sounding the tone before it is replaced.
+static void _KeyOffTone(uint8_t tone_num) {
+
+	uint8_t v = VoiceAlloc_FirstActive(&_voice_alloc);
+	uint8_t next = VOICE_ALLOC_NONE;
+
+	while ( v != VOICE_ALLOC_NONE ) {
+		next = VoiceAlloc_NextActive(&_voice_alloc, v);
+		if ( _voice_tone[v] == tone_num ) {
+			YMF825_KeyOffVoice(_SelectVoice(v), tone_num);
+			VoiceAlloc_Release(&_voice_alloc, v);
+		}
+		v = next;
+	}
+}
+
+static void _KeyOffChannel(uint8_t ch) {
+
+	uint8_t v = VoiceAlloc_FirstActive(&_voice_alloc);
+	uint8_t next = VOICE_ALLOC_NONE;
+
+	while ( v != VOICE_ALLOC_NONE ) {
+		next = VoiceAlloc_NextActive(&_voice_alloc, v);
+		if ( _voice_alloc.voice[v].ch == ch ) {
+			YMF825_KeyOffVoice(_SelectVoice(v), _voice_tone[v]);
+			VoiceAlloc_Release(&_voice_alloc, v);
+		}
+		v = next;
+	}
+}
+
+// the uploaded bank replaces all slots, the slot n is the program of the channel n (as mode4).
+static void _ApplyToneBank(uint8_t bank[YMF825_TONE_BANK_SLOT_NUM][YMF825_TONE_BANK_BLOCK_SIZE]) {
+
+	uint8_t i = 0;
+
+	for ( i = 0; i < MAX_CH_NUMBER; i++ ) {
+		_KeyOffChannel(i);
+	}
+	memset(_program_slot, TONE_SLOT_NONE, sizeof(_program_slot));
+	for ( i = 0; i < MAX_TONE_NUMBER; i++ ) {
+		memcpy(_tone_tbl[i], bank[i], NUM_OF_TONE_CFG);
+		_tone_slot[i].program = PROGRAM_BANK(i);
+		_tone_slot[i].ref = 1;
+		_tone_slot[i].last_use = ++_use_clock;
+		_program_slot[PROGRAM_BANK(i)] = i;
+		_ch_program[i] = PROGRAM_BANK(i);
+	}
+	_dirty_tone_mask = 0xFFFF;
+	_UploadDirtyTones();
+}
+
+// the chip takes the tones from #0 up to the given number,
+// so the upload is cut after the last dirty slot. all chips take the same upload at once. the pending uploads are merged by the driver.
+static void _UploadDirtyTones(void) {
+
+	uint8_t block_num = MAX_TONE_NUMBER;
+
+	if ( _dirty_tone_mask == 0 ) {
+		return;
+	}
+	while ( ( _dirty_tone_mask & (1U << (block_num - 1)) ) == 0 ) {
+		block_num--;
+	}
+	YMF825_RequestToneParameter(_tone_tbl, block_num);
+	_dirty_tone_mask = 0;
+}
+
+static void _UpdateVolumeCache(uint8_t ch) {
+
+	_play_tuning[ch].VoVol = Volume_GetYMF825Level(_play_tuning[ch].ChannelVolume);
+	_play_tuning[ch].ChVolGain = Volume_GetYMF825Gain(_play_tuning[ch].Expression);
+}
+
+static void _UpdatePitchCache(uint8_t ch) {
+
+	PitchBend_ToYMF825(
+		PitchBend_GetFreqRatio(_play_tuning[ch].PitchBendSensitibity, _play_tuning[ch].PitchBend),
+		&_play_tuning[ch].INT, &_play_tuning[ch].FRAC);
+}
\ No newline at end of file
@@ -0,0 +1,42 @@
+/*
+  MIT License
+
+  Copyright (c) 2020 nyannkov
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+#ifndef __POLY_YMF825_H__
+#define __POLY_YMF825_H__
+
+#include "midi.h"
+#include "voice_alloc.h"
+
+#pragma pack(1)
+typedef struct
+{
+  uint8_t voice_steal;    // VoiceAlloc_Steal_t. The voice to be stolen when all voices are busy.
+} poly_ymf825_config_t;
+#pragma pack()
+
+extern const MIDI_Message_Callbacks_t *MIDI_Poly_YMF825_Init(void);
+extern void MIDI_Poly_YMF825_DeInit(void);
+extern int32_t SetConfig_Poly_YMF825(const poly_ymf825_config_t *cfg);
+extern int32_t GetConfig_Poly_YMF825(poly_ymf825_config_t *out);
+
+#endif /* __POLY_YMF825_H__ */
\ No newline at end of file
@@ -0,0 +1,262 @@
+/*
+  MIT License
+
+  Copyright (c) 2020 nyannkov
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+#include "ymf825_tone_bank.h"
+#include <string.h> // memcpy
+
+#define TONE_BANK_MANUFACTURER_ID	0x7D
+#define TONE_BANK_CMD_WRITE		0x01
+#define TONE_BANK_CMD_COMMIT		0x02
+
+#define TONE_BANK_BANK_SIZE		(YMF825_TONE_BANK_SLOT_NUM * YMF825_TONE_BANK_BLOCK_SIZE)
+
+typedef enum
+{
+	TONE_BANK_RX_MANUFACTURER = 0,	// waiting for the manufacturer ID
+	TONE_BANK_RX_COMMAND,		// waiting for the command
+	TONE_BANK_RX_SLOT,		// write: waiting for the first slot
+	TONE_BANK_RX_COUNT,		// write: waiting for the number of blocks
+	TONE_BANK_RX_DATA,		// write: receiving the packed tone data
+	TONE_BANK_RX_COMMIT,		// commit: waiting for F7
+	TONE_BANK_RX_IGNORE		// not for us, or broken
+} tone_bank_rx_state_t;
+
+typedef struct
+{
+	tone_bank_rx_state_t state;
+	uint8_t  slot;
+	uint8_t  count;
+	uint8_t  msb;		// MSBs of the current 7 bytes group
+	uint8_t  group_pos;	// 0: next byte is the MSBs, 1-7: data
+	uint16_t pos;		// write position in the back bank
+	uint16_t end;		// end of the write position
+} tone_bank_rx_t;
+
+extern const uint8_t ymf825_tone_table[128][30];
+
+static void _DropPartialWrite(void);
+static void _tone_bank_SysExStart(void);
+static void _tone_bank_SysExData(const uint8_t *dat, size_t len);
+static void _tone_bank_SysExEnd(uint8_t complete);
+
+static const MIDI_Message_Callbacks_t _tone_bank_midi_msg_callbacks = {
+	// MIDI_ChannelMessage_t
+	{
+		// MIDI_ChannelVoiceMessage_t
+		{
+			NULL,
+			NULL,
+			NULL,
+			NULL,
+			NULL,
+			NULL,
+			NULL
+		}
+	},
+	// MIDI_SystemMessage_t
+	{
+		// MIDI_SystemExclusiveMessage_t
+		{
+			NULL,
+			_tone_bank_SysExStart,
+			_tone_bank_SysExData,
+			_tone_bank_SysExEnd
+		}
+	}
+};
+
+// front: applied to the chip, back: written by SysEx.
+static uint8_t _bank[2][YMF825_TONE_BANK_SLOT_NUM][YMF825_TONE_BANK_BLOCK_SIZE];
+static uint8_t _front_idx = 0;
+static uint8_t _apply_pending = 0;
+static uint8_t _committed = 0; // a bank has been committed since the init
+static pf_ymf825_tone_bank_apply_t _apply_hook = NULL;
+static tone_bank_rx_t _rx;
+static ymf825_tone_bank_stat_t _stat;
+
+const MIDI_Message_Callbacks_t *MIDI_ToneBank_YMF825_Init(void) {
+
+	uint32_t i = 0;
+
+	for ( i = 0; i < YMF825_TONE_BANK_SLOT_NUM; i++ ) {
+		memcpy(_bank[0][i], ymf825_tone_table[0], YMF825_TONE_BANK_BLOCK_SIZE);
+	}
+	memcpy(_bank[1], _bank[0], TONE_BANK_BANK_SIZE);
+
+	_front_idx = 0;
+	_apply_pending = 0;
+	_committed = 0;
+	_rx.state = TONE_BANK_RX_IGNORE;
+	memset(&_stat, 0, sizeof(_stat));
+
+	return &_tone_bank_midi_msg_callbacks;
+}
+
+// the hook is called with the front bank. NULL: the bank is kept but not applied.
+// a committed bank is applied again when a hook is installed, since the sound driver has just been initialized.
+void SetApplyHook_ToneBank_YMF825(pf_ymf825_tone_bank_apply_t hook) {
+
+	_apply_hook = hook;
+	if ( ( hook != NULL ) && _committed ) {
+		_apply_pending = 1;
+	}
+}
+
+// called from the main loop, where no MIDI message is being processed.
+void Task_ToneBank_YMF825(void) {
+
+	// kept pending while no hook is installed.
+	if ( _apply_pending && ( _apply_hook != NULL ) ) {
+		_apply_pending = 0;
+		_apply_hook(_bank[_front_idx]);
+		_stat.apply_count++;
+	}
+}
+
+void GetStat_ToneBank_YMF825(ymf825_tone_bank_stat_t *out) {
+
+	*out = _stat;
+}
+
+static void _tone_bank_SysExStart(void) {
+
+	_rx.state = TONE_BANK_RX_MANUFACTURER;
+}
+
+static void _tone_bank_SysExData(const uint8_t *dat, size_t len) {
+
+	uint8_t *pback = &_bank[_front_idx ^ 1][0][0];
+	size_t i = 0;
+
+	for ( i = 0; i < len; i++ ) {
+
+		switch ( _rx.state ) {
+			case TONE_BANK_RX_MANUFACTURER:
+			_rx.state = ( dat[i] == TONE_BANK_MANUFACTURER_ID ) ? TONE_BANK_RX_COMMAND : TONE_BANK_RX_IGNORE;
+			break;
+
+			case TONE_BANK_RX_COMMAND:
+			if ( dat[i] == TONE_BANK_CMD_WRITE ) {
+				_rx.state = TONE_BANK_RX_SLOT;
+			}
+			else if ( dat[i] == TONE_BANK_CMD_COMMIT ) {
+				_rx.state = TONE_BANK_RX_COMMIT;
+			}
+			else {
+				_rx.state = TONE_BANK_RX_IGNORE;
+			}
+			break;
+
+			case TONE_BANK_RX_SLOT:
+			_rx.slot = dat[i];
+			_rx.state = TONE_BANK_RX_COUNT;
+			break;
+
+			case TONE_BANK_RX_COUNT:
+			_rx.count = dat[i];
+			if ( ( _rx.count == 0 ) || ( _rx.slot + _rx.count > YMF825_TONE_BANK_SLOT_NUM ) ) {
+				_stat.error_count++;
+				_rx.state = TONE_BANK_RX_IGNORE;
+			}
+			else {
+				_rx.pos = _rx.slot * YMF825_TONE_BANK_BLOCK_SIZE;
+				_rx.end = _rx.pos + _rx.count * YMF825_TONE_BANK_BLOCK_SIZE;
+				_rx.group_pos = 0;
+				_rx.state = TONE_BANK_RX_DATA;
+			}
+			break;
+
+			case TONE_BANK_RX_DATA:
+			if ( ( dat[i] & 0x80 ) || ( _rx.pos >= _rx.end ) ) {
+				// not a data byte, or too long (also a byte after the last full group).
+				_stat.error_count++;
+				_DropPartialWrite();
+				_rx.state = TONE_BANK_RX_IGNORE;
+			}
+			else if ( _rx.group_pos == 0 ) {
+				_rx.msb = dat[i];
+				_rx.group_pos = 1;
+			}
+			else {
+				pback[_rx.pos++] = dat[i] | ( ( ( _rx.msb >> ( _rx.group_pos - 1 ) ) & 0x01 ) << 7 );
+				_rx.group_pos = ( _rx.group_pos >= 7 ) ? 0 : _rx.group_pos + 1;
+			}
+			break;
+
+			case TONE_BANK_RX_COMMIT:
+			// a commit has no data.
+			_stat.error_count++;
+			_rx.state = TONE_BANK_RX_IGNORE;
+			break;
+
+			default:
+			return;
+		}
+	}
+}
+
+static void _tone_bank_SysExEnd(uint8_t complete) {
+
+	if ( !complete ) {
+		if ( _rx.state != TONE_BANK_RX_IGNORE ) {
+			_stat.error_count++;
+		}
+		if ( _rx.state == TONE_BANK_RX_DATA ) {
+			_DropPartialWrite();
+		}
+	}
+	else if ( _rx.state == TONE_BANK_RX_DATA ) {
+		if ( _rx.pos == _rx.end ) {
+			_stat.write_count++;
+		}
+		else {
+			// too short.
+			_stat.error_count++;
+			_DropPartialWrite();
+		}
+	}
+	else if ( _rx.state == TONE_BANK_RX_COMMIT ) {
+		// swap, and start the next back bank from the committed one.
+		_front_idx ^= 1;
+		memcpy(_bank[_front_idx ^ 1], _bank[_front_idx], TONE_BANK_BANK_SIZE);
+		_apply_pending = 1;
+		_committed = 1;
+		_stat.commit_count++;
+	}
+	else if ( ( _rx.state == TONE_BANK_RX_SLOT ) || ( _rx.state == TONE_BANK_RX_COUNT ) ) {
+		_stat.error_count++;
+	}
+	else {
+	}
+
+	_rx.state = TONE_BANK_RX_IGNORE;
+}
+
+// restore the blocks of the broken write message from the front bank.
+static void _DropPartialWrite(void) {
+
+	size_t offset = _rx.slot * YMF825_TONE_BANK_BLOCK_SIZE;
+	size_t size = _rx.count * YMF825_TONE_BANK_BLOCK_SIZE;
+
+	memcpy(&_bank[_front_idx ^ 1][0][0] + offset, &_bank[_front_idx][0][0] + offset, size);
+}
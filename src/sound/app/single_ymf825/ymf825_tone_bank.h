@@ -0,0 +1,59 @@
+/*
+  MIT License
+
+  Copyright (c) 2020 nyannkov
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+#ifndef __YMF825_TONE_BANK_H__
+#define __YMF825_TONE_BANK_H__
+
+#include "midi.h"
+
+/*
+	SysEx tone bank upload (manufacturer ID 0x7D: non-commercial)
+
+	write : F0 7D 01 <slot> <count> <data> F7
+		Writes <count> (1-16) tone blocks of 30 bytes into the back bank from <slot> (0-15).
+		<data> is the tone blocks packed in 7 bits: each group of up to 7 bytes is
+		preceded by one byte which holds their MSBs (bit n: MSB of the n-th byte).
+	commit: F0 7D 02 F7
+		Swaps the back bank with the front bank, and applies the front bank to
+		the chip at the next safe point (Task_ToneBank_YMF825).
+*/
+
+#define YMF825_TONE_BANK_SLOT_NUM	16
+#define YMF825_TONE_BANK_BLOCK_SIZE	30
+
+typedef void (*pf_ymf825_tone_bank_apply_t)(uint8_t bank[YMF825_TONE_BANK_SLOT_NUM][YMF825_TONE_BANK_BLOCK_SIZE]);
+
+typedef struct
+{
+	uint32_t write_count;	// accepted write messages
+	uint32_t commit_count;	// accepted commit messages
+	uint32_t apply_count;	// banks applied to the chip
+	uint32_t error_count;	// discarded messages
+} ymf825_tone_bank_stat_t;
+
+extern const MIDI_Message_Callbacks_t *MIDI_ToneBank_YMF825_Init(void);
+extern void SetApplyHook_ToneBank_YMF825(pf_ymf825_tone_bank_apply_t hook);
+extern void Task_ToneBank_YMF825(void);
+extern void GetStat_ToneBank_YMF825(ymf825_tone_bank_stat_t *out);
+
+#endif /* __YMF825_TONE_BANK_H__ */
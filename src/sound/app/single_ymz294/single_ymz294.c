@@ -21,9 +21,10 @@
   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
   SOFTWARE.
 */
-#include <math.h>
 #include "single_ymz294.h"
 #include "ymz294.h"
+#include "pitch_bend.h"
+#include "volume.h"
 
 #define YMZ294_CHANNEL_A        0
 #define YMZ294_CHANNEL_B        1
@@ -33,6 +34,8 @@
 #define YMZ294_NOTE_OFF         0 
 #define YMZ294_NOTE_ON          1
 
+#define YMZ294_VOICE_NONE       0xFF
+
 
 
 #pragma pack(1)
@@ -50,6 +53,10 @@ typedef struct _MIDI_PlayTuning
 	uint8_t PitchBendSensitibity;
 	uint8_t ChannelVolume;
 	uint8_t Expression;
+	uint16_t PitchBend;
+	// derived values, updated only when the parameters above change.
+	uint8_t Level;		// of Expression
+	uint32_t TpRatio;	// of PitchBend and PitchBendSensitibity (Q16)
 	// YMZ294 parameters
 	ymz294_setting_t ymz294_setting;
 } MIDI_PlayTuning_t;
@@ -59,18 +66,15 @@ typedef struct
 	uint8_t key_stat; // current key state (on/off)
 	uint8_t note_no;  // note number
 	uint8_t mid_ch;   // midi channel
+	uint32_t order;   // when the key state changed, for the oldest note
 } ymz294_ch_stat_t;
 #pragma pack()
 
 
 static MIDI_PlayTuning_t _play_tuning[MAX_MIDI_CH_NUMBER];
 
-static ymz294_ch_stat_t _ch_stat[NUM_OF_YMZ294_CHANNEL] = 
-{
-	{YMZ294_NOTE_OFF, 0, 0},// CHANNEL A
-	{YMZ294_NOTE_OFF, 0, 0},// CHANNEL B
-	{YMZ294_NOTE_OFF, 0, 0} // CHANNEL C
-};
+static ymz294_ch_stat_t _ch_stat[NUM_OF_YMZ294_CHANNEL];
+static uint32_t _ch_stat_order;
 
 
 static const uint16_t _note_tp_tbl[128] = 
@@ -93,6 +97,10 @@ static const uint16_t _note_tp_tbl[128] =
 	0x000F, 0x000E, 0x000D, 0x000D, 0x000C, 0x000B, 0x000B, 0x000A,
 };
 
+static void _ChannelKeyOff(uint8_t midi_ch);
+static uint8_t _AllocVoice(uint8_t midi_ch, uint8_t kk);
+static void _KeyOffVoice(uint8_t ymz294_ch);
+static void _WriteTp(uint8_t ymz294_ch, uint16_t tp);
 static void _ymz294_NoteOff(uint8_t ch, uint8_t kk, uint8_t uu);
 static void _ymz294_NoteOn(uint8_t ch, uint8_t kk, uint8_t vv);
 //static void _ymz294_PolyphonicKeyPressure(uint8_t ch, uint8_t kk, uint8_t vv);
@@ -100,6 +108,7 @@ static void _ymz294_ControlChange(uint8_t ch, uint8_t cc, uint8_t vv);
 //static void _ymz294_ProgramChange(uint8_t ch, uint8_t pp);
 //static void _ymz294_ChannelPressure(uint8_t ch, uint8_t vv);
 static void _ymz294_PitchBendChange(uint8_t ch, uint8_t ll, uint8_t hh);
+static void _UpdatePitchCache(uint8_t ch);
 
 static const MIDI_Message_Callbacks_t _ymz294_midi_msg_callbacks =
 {
@@ -126,24 +135,22 @@ static const MIDI_Message_Callbacks_t _ymz294_midi_msg_callbacks =
 };
 
 
-static uint8_t mixer_value = 0x0000;
-static uint16_t env_frq_value = 0x0000;
-static uint16_t noise_frq_value = 0x0000;
+const MIDI_Message_Callbacks_t *midi_ymz294_init(void) {
 
-MIDI_Handle_t *midi_ymz294_init(void) {
-
-	MIDI_Handle_t *phMIDI = NULL;
 	uint32_t i = 0;
 
 	ymz294_init();
 
 	// set mixer
-	mixer_value = 0x38;
-	ymz294_write(0x07, mixer_value);
+	ymz294_write(0x07, 0x38);
 	// set volume
-	ymz294_write(0x08, 0x00);
-	ymz294_write(0x09, 0x00);
-	ymz294_write(0x0A, 0x00);
+	_ch_stat_order = 0;
+	for ( i = 0; i < NUM_OF_YMZ294_CHANNEL; i++ )
+	{
+		ymz294_write(0x08 + i, 0x00);
+		_ch_stat[i].key_stat = YMZ294_NOTE_OFF;
+		_ch_stat[i].order = 0;
+	}
 
 	for ( i = 0; i < MAX_MIDI_CH_NUMBER; i++ )
 	{
@@ -153,19 +160,21 @@ MIDI_Handle_t *midi_ymz294_init(void) {
 		_play_tuning[i].ymz294_setting.env_shape	= 0x09;
 		_play_tuning[i].ymz294_setting.sel_mixer	= YMZ294_MIXER_TONE;
 		_play_tuning[i].ymz294_setting.noise_freq	= 0;
+		_play_tuning[i].ymz294_setting.voice_mask	= YMZ294_VOICE_MASK_ALL;
+
+		_play_tuning[i].PitchBend = 8192;
+		_play_tuning[i].Level = Volume_GetYMZ294Level(_play_tuning[i].Expression);
+		_UpdatePitchCache(i);
 	}
 	_play_tuning[9].ymz294_setting.ch_enabled 	= YMZ294_CH_ENABLED_FALSE;// noise channel (default disable)
 	_play_tuning[9].ymz294_setting.sel_mixer  	= YMZ294_MIXER_NOISE;
 	_play_tuning[9].ymz294_setting.env_mode 	= YMZ294_ENVELOPE_ENABLE;
 
-	phMIDI = MIDI_Init(&_ymz294_midi_msg_callbacks);
-
-	return phMIDI;
+	return &_ymz294_midi_msg_callbacks;
 }
 
-void midi_ymz294_deinit(MIDI_Handle_t *phMIDI) {
-
-	MIDI_DeInit(phMIDI);
+void midi_ymz294_deinit(void) {
+	// nothing to release.
 }
 
 
@@ -181,12 +190,17 @@ int32_t set_ymz294_setting(uint8_t midi_ch, const ymz294_setting_t *p_setting)
 	}
 	else
 	{
+		if ( p_setting->ch_enabled == YMZ294_CH_ENABLED_FALSE )
+		{// messages of the disabled channel are no longer received, release its voices now.
+			_ChannelKeyOff(midi_ch);
+		}
 		_play_tuning[midi_ch].ymz294_setting.ch_enabled = p_setting->ch_enabled;
 		_play_tuning[midi_ch].ymz294_setting.sel_mixer 	= p_setting->sel_mixer;
 		_play_tuning[midi_ch].ymz294_setting.env_mode	= p_setting->env_mode;
 		_play_tuning[midi_ch].ymz294_setting.env_shape	= p_setting->env_shape;
 		_play_tuning[midi_ch].ymz294_setting.env_freq	= p_setting->env_freq;
 		_play_tuning[midi_ch].ymz294_setting.noise_freq	= p_setting->noise_freq;
+		_play_tuning[midi_ch].ymz294_setting.voice_mask	= p_setting->voice_mask & YMZ294_VOICE_MASK_ALL;
 
 		return 0;
 	}
@@ -210,11 +224,39 @@ int32_t get_ymz294_setting(uint8_t midi_ch, ymz294_setting_t *dest_buf)
 		dest_buf->env_shape		= _play_tuning[midi_ch].ymz294_setting.env_shape;
 		dest_buf->env_freq		= _play_tuning[midi_ch].ymz294_setting.env_freq;
 		dest_buf->noise_freq	= _play_tuning[midi_ch].ymz294_setting.noise_freq;
+		dest_buf->voice_mask	= _play_tuning[midi_ch].ymz294_setting.voice_mask;
 
 		return 0;
 	}
 }
 
+uint16_t get_ymz294_ch_mask(void)
+{
+	uint16_t ch_mask = 0;
+	uint32_t i = 0;
+	for ( i = 0; i < MAX_MIDI_CH_NUMBER; i++ )
+	{
+		if ( _play_tuning[i].ymz294_setting.ch_enabled != YMZ294_CH_ENABLED_FALSE )
+		{
+			ch_mask |= 1U << i;
+		}
+	}
+	return ch_mask;
+}
+
+static void _ChannelKeyOff(uint8_t midi_ch)
+{
+	uint32_t i = 0;
+	for ( i = 0; i < NUM_OF_YMZ294_CHANNEL; i++ )
+	{
+		if (( _ch_stat[i].key_stat  == YMZ294_NOTE_ON )
+		&&  ( _ch_stat[i].mid_ch == midi_ch ))
+		{
+			_KeyOffVoice(i);
+		}
+	}
+}
+
 static void _ymz294_NoteOff(uint8_t ch, uint8_t kk, uint8_t uu)
 {
 	uint32_t i = 0;
@@ -225,71 +267,115 @@ static void _ymz294_NoteOff(uint8_t ch, uint8_t kk, uint8_t uu)
 		&&  ( _ch_stat[i].mid_ch == ch ))
 		{
 			// note off
-			ymz294_write(0x08 + i, 0);
-			
-			// update a channel status.
-			_ch_stat[i].key_stat = YMZ294_NOTE_OFF;
+			_KeyOffVoice(i);
 			break;
 		}
 	}
 }
 
+/*
+	Voice of a new note, among the voices the MIDI channel may use (voice_mask).
+	The last note has priority, so the note always gets a voice if the mask is not empty:
+	1. the voice already playing the same key (retriggered)
+	2. the free voice released the longest ago
+	3. the oldest sounding voice (stolen)
+	With 3 voices, a scan costs less than any index.
+*/
+static uint8_t _AllocVoice(uint8_t midi_ch, uint8_t kk)
+{
+	uint8_t mask = _play_tuning[midi_ch].ymz294_setting.voice_mask;
+	uint8_t free_voice = YMZ294_VOICE_NONE;
+	uint8_t oldest_voice = YMZ294_VOICE_NONE;
+	uint32_t i = 0;
+
+	for ( i = 0; i < NUM_OF_YMZ294_CHANNEL; i++ )
+	{
+		if ( ( mask & (1U << i) ) == 0 )
+		{
+			continue;
+		}
+		if ( _ch_stat[i].key_stat == YMZ294_NOTE_ON )
+		{
+			if (( _ch_stat[i].note_no == kk )
+			&&  ( _ch_stat[i].mid_ch == midi_ch ))
+			{
+				return i;
+			}
+			if (( oldest_voice == YMZ294_VOICE_NONE )
+			||  ( (int32_t)(_ch_stat[i].order - _ch_stat[oldest_voice].order) < 0 ))
+			{
+				oldest_voice = i;
+			}
+		}
+		else
+		{
+			if (( free_voice == YMZ294_VOICE_NONE )
+			||  ( (int32_t)(_ch_stat[i].order - _ch_stat[free_voice].order) < 0 ))
+			{
+				free_voice = i;
+			}
+		}
+	}
+	return ( free_voice != YMZ294_VOICE_NONE ) ? free_voice : oldest_voice;
+}
+
+static void _KeyOffVoice(uint8_t ymz294_ch)
+{
+	ymz294_write(0x08 + ymz294_ch, 0);
+	_ch_stat[ymz294_ch].key_stat = YMZ294_NOTE_OFF;
+	_ch_stat[ymz294_ch].order = ++_ch_stat_order;
+}
+
+// unchanged bytes are dropped by the driver.
+static void _WriteTp(uint8_t ymz294_ch, uint16_t tp)
+{
+	ymz294_write(2*ymz294_ch+1, (tp>>8) & 0x00FFU);
+	ymz294_write(2*ymz294_ch, tp & 0x00FFU);
+}
+
 
 static void key_on(uint8_t ymz294_ch, uint8_t midi_ch, uint8_t kk, uint8_t vv)
 {
 	// set mixer
 	{
-		uint8_t mixer_value_tmp = mixer_value;
+		uint8_t mixer_value = ymz294_read_shadow(0x07);
 		if ( _play_tuning[midi_ch].ymz294_setting.sel_mixer == YMZ294_MIXER_TONE )
 		{
-			mixer_value_tmp |=	 1 << (ymz294_ch + 3);
-			mixer_value_tmp &= ~(1 <<  ymz294_ch);
+			mixer_value |=	 1 << (ymz294_ch + 3);
+			mixer_value &= ~(1 <<  ymz294_ch);
+			uint16_t tp = _note_tp_tbl[kk];
+			if ( _play_tuning[midi_ch].TpRatio != PITCH_BEND_RATIO_ONE )
+			{// start at the current pitch bend
+				tp = PitchBend_ScaleTp(tp, _play_tuning[midi_ch].TpRatio);
+			}
 			// set TP
-			ymz294_write(2*ymz294_ch+1, (_note_tp_tbl[kk]>>8) & 0x00FFU);
-			ymz294_write(2*ymz294_ch, _note_tp_tbl[kk] & 0x00FFU);
+			_WriteTp(ymz294_ch, tp);
 		}
 		else
 		{
-			mixer_value_tmp |=	 1 <<  ymz294_ch;
-			mixer_value_tmp &= ~(1 << (ymz294_ch + 3));
+			mixer_value |=	 1 <<  ymz294_ch;
+			mixer_value &= ~(1 << (ymz294_ch + 3));
 			// set NP
-			if ( noise_frq_value != _play_tuning[midi_ch].ymz294_setting.noise_freq )
-			{
-				noise_frq_value = _play_tuning[midi_ch].ymz294_setting.noise_freq;
-				ymz294_write(0x06, noise_frq_value);
-			}
+			ymz294_write(0x06, _play_tuning[midi_ch].ymz294_setting.noise_freq);
 		}
 
-		if ( mixer_value != mixer_value_tmp )
-		{
-			mixer_value = mixer_value_tmp;
-			ymz294_write(0x07, mixer_value);
-		}
+		ymz294_write(0x07, mixer_value);
 	}
 	// set volume
 	{
 		if ( _play_tuning[midi_ch].ymz294_setting.env_mode == YMZ294_ENVELOPE_ENABLE )
 		{
 			// set envelope frequency
-			{
-				if ( env_frq_value != _play_tuning[midi_ch].ymz294_setting.env_freq )
-				{
-					env_frq_value = _play_tuning[midi_ch].ymz294_setting.env_freq;
-					ymz294_write(0x0B,  env_frq_value       & 0x00FF);
-					ymz294_write(0x0C, (env_frq_value >> 8) & 0x00FF);
-				}
-			}
+			ymz294_write(0x0B,  _play_tuning[midi_ch].ymz294_setting.env_freq       & 0x00FF);
+			ymz294_write(0x0C, (_play_tuning[midi_ch].ymz294_setting.env_freq >> 8) & 0x00FF);
 			ymz294_write(0x08 + ymz294_ch, 0x10);
-			ymz294_write(0x0D, _play_tuning[midi_ch].ymz294_setting.env_shape);
+			// written every time, it restarts the envelope.
+			ymz294_write_force(0x0D, _play_tuning[midi_ch].ymz294_setting.env_shape);
 		}
 		else
 		{
-			uint8_t level = 0;
-			float fvelocity = 0.0F;
-			fvelocity  = ((float)(_play_tuning[midi_ch].Expression & 0x7F))/127.0F;
-			level = (uint8_t)((float)15 * fvelocity);
 			// set volume
-			ymz294_write(0x08 + ymz294_ch, level);
+			ymz294_write(0x08 + ymz294_ch, _play_tuning[midi_ch].Level);
 		}
 	}
 }
@@ -297,27 +383,22 @@ static void key_on(uint8_t ymz294_ch, uint8_t midi_ch, uint8_t kk, uint8_t vv)
 
 static void _ymz294_NoteOn(uint8_t ch, uint8_t kk, uint8_t vv)
 {
-	uint32_t i = 0;
+	uint8_t i = YMZ294_VOICE_NONE;
 
-	if ( _play_tuning[ch].ymz294_setting.ch_enabled == YMZ294_CH_ENABLED_FALSE )
-	{
-		return;
-	}
+	// messages of disabled channels are filtered out by the parser (see get_ymz294_ch_mask).
 	if ( vv != 0 )
 	{// note on
-		for ( i = 0; i < NUM_OF_YMZ294_CHANNEL; i++ )
-		{
-			if ( _ch_stat[i].key_stat == YMZ294_NOTE_OFF )
-			{// note on
+		i = _AllocVoice(ch, kk);
+		if ( i != YMZ294_VOICE_NONE )
+		{// note on. a stolen voice is not keyed off, its registers are overwritten.
 
-				key_on(i, ch, kk, vv);
+			key_on(i, ch, kk, vv);
 
-				// update a channel status.
-				_ch_stat[i].key_stat = YMZ294_NOTE_ON;
-				_ch_stat[i].note_no = kk;
-				_ch_stat[i].mid_ch = ch;
-				break;
-			}
+			// update a channel status.
+			_ch_stat[i].key_stat = YMZ294_NOTE_ON;
+			_ch_stat[i].note_no = kk;
+			_ch_stat[i].mid_ch = ch;
+			_ch_stat[i].order = ++_ch_stat_order;
 		}
 	}
 	else
@@ -340,6 +421,7 @@ static void _ymz294_ControlChange(uint8_t ch, uint8_t cc, uint8_t vv)
 				case 0x0000:// Pitch Bend Sensitibity;
 				{
 					_play_tuning[ch].PitchBendSensitibity = _play_tuning[ch].DAT.MSB;
+					_UpdatePitchCache(ch);
 				}
 				break;
 
@@ -364,12 +446,10 @@ static void _ymz294_ControlChange(uint8_t ch, uint8_t cc, uint8_t vv)
 		case 11:// Expression
 		{
 			int i = 0;
-			float fvelocity = 0.0F;
 			uint8_t level = 0;
 			_play_tuning[ch].Expression = vv;
-			fvelocity  = ((float)(vv & 0x7F))/127.0F;
-
-			level = (uint8_t)((float)15 * fvelocity);
+			_play_tuning[ch].Level = Volume_GetYMZ294Level(vv);
+			level = _play_tuning[ch].Level;
 
 			// note on
 			for ( i = 0; i < NUM_OF_YMZ294_CHANNEL; i++ )
@@ -377,8 +457,11 @@ static void _ymz294_ControlChange(uint8_t ch, uint8_t cc, uint8_t vv)
 				if (( _ch_stat[i].mid_ch == ch )
 				&&  ( _ch_stat[i].key_stat == YMZ294_NOTE_ON))
 				{// note on
-					// set TP
-					ymz294_write(0x08 + i, level);
+					// set volume
+					if ( _play_tuning[ch].ymz294_setting.env_mode != YMZ294_ENVELOPE_ENABLE )
+					{
+						ymz294_write(0x08 + i, level);
+					}
 				}
 			}
 		}
@@ -394,6 +477,7 @@ static void _ymz294_ControlChange(uint8_t ch, uint8_t cc, uint8_t vv)
 				case 0x0000:// Pitch Bend Sensitibity;
 				{
 					_play_tuning[ch].PitchBendSensitibity = _play_tuning[ch].DAT.MSB;
+					_UpdatePitchCache(ch);
 				}
 				break;
 
@@ -426,12 +510,7 @@ static void _ymz294_ControlChange(uint8_t ch, uint8_t cc, uint8_t vv)
 		/*FALLTHROUGH*/
 		case 123:// All Note Off
 		{
-			uint32_t i = 0;
-			for ( i = 0; i < NUM_OF_YMZ294_CHANNEL; i++ )
-			{
-				ymz294_write(0x08 + i, 0); // note off
-				_ch_stat[i].key_stat = YMZ294_NOTE_OFF;
-			}
+			_ChannelKeyOff(ch);
 			// RPN
 			_play_tuning[ch].RPN.MSB = 0x7F;
 			_play_tuning[ch].RPN.LSB = 0x7F;
@@ -440,6 +519,9 @@ static void _ymz294_ControlChange(uint8_t ch, uint8_t cc, uint8_t vv)
 			_play_tuning[ch].PitchBendSensitibity = 2;
 			_play_tuning[ch].Expression = 0x7F;
 			_play_tuning[ch].ChannelVolume = 64;
+			_play_tuning[ch].PitchBend = 8192;
+			_play_tuning[ch].Level = Volume_GetYMZ294Level(_play_tuning[ch].Expression);
+			_UpdatePitchCache(ch);
 		}
 		break;
 
@@ -453,21 +535,24 @@ static void _ymz294_PitchBendChange(uint8_t ch, uint8_t ll, uint8_t hh)
 {
 	uint32_t i = 0;
 	uint16_t changed_note = 0;
-	uint16_t shift = 0;
-	float fratio = 0.0F;
 
-	shift = (hh << 7) | ll;
-	fratio = (float)pow(2.0, (double)_play_tuning[ch].PitchBendSensitibity / 12.0 * (double)(shift-8192) / 8192.0 * -1); // @note * The reason for multiplying by -1 is that the frequency is inversely proportional to Tp.
+	_play_tuning[ch].PitchBend = (hh << 7) | ll;
+	_UpdatePitchCache(ch);
 
 	for ( i = 0; i < NUM_OF_YMZ294_CHANNEL; i++ )
 	{
 		if (( _ch_stat[i].mid_ch == ch )
 		&&  ( _ch_stat[i].key_stat == YMZ294_NOTE_ON))
 		{
-			changed_note = _note_tp_tbl[_ch_stat[i].note_no] * fratio;
+			changed_note = PitchBend_ScaleTp(_note_tp_tbl[_ch_stat[i].note_no], _play_tuning[ch].TpRatio);
 			// set TP
-			ymz294_write(2*i+1, (changed_note>>8) & 0x00FFU);
-			ymz294_write(2*i,	changed_note	 & 0x00FFU);
+			_WriteTp(i, changed_note);
 		}
 	}
 }
+
+static void _UpdatePitchCache(uint8_t ch)
+{
+	// @note Tp is inversely proportional to the frequency.
+	_play_tuning[ch].TpRatio = PitchBend_GetTpRatio(_play_tuning[ch].PitchBendSensitibity, _play_tuning[ch].PitchBend);
+}
@@ -38,6 +38,8 @@
 #define YMZ294_MIXER_TONE  		0
 #define YMZ294_MIXER_NOISE 		1
 
+#define YMZ294_VOICE_MASK_ALL	0x07 // bit0: channel A, bit1: B, bit2: C
+
 typedef struct
 {
 	uint8_t  ch_enabled;
@@ -46,12 +48,14 @@ typedef struct
 	uint8_t  env_shape;
 	uint16_t env_freq;
 	uint16_t noise_freq;
+	uint8_t  voice_mask; // YMZ294 channels the MIDI channel may use. clear a bit on the others to reserve it.
 } ymz294_setting_t;
 
 
-extern MIDI_Handle_t *midi_ymz294_init(void);
-extern void midi_ymz294_deinit(MIDI_Handle_t *phMIDI);
+extern const MIDI_Message_Callbacks_t *midi_ymz294_init(void);
+extern void midi_ymz294_deinit(void);
 extern int32_t set_ymz294_setting(uint8_t midi_ch, const ymz294_setting_t *p_settings);
 extern int32_t get_ymz294_setting(uint8_t midi_ch, ymz294_setting_t *dest_buf);
+extern uint16_t get_ymz294_ch_mask(void);
 
 #endif//__SINGLE_YMZ294_H__
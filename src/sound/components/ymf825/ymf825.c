@@ -25,8 +25,13 @@
   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
   SOFTWARE.
 */
+#include <string.h>
 #include <gd32vf103_gpio.h>
 #include <gd32vf103_spi.h>
+#ifdef USE_YMF825_SPI_DMA
+#include <gd32vf103_dma.h>
+#include <gd32vf103_eclic.h>
+#endif
 #include "freerun_timer.h"
 #include "ymf825.h"
 
@@ -37,17 +42,112 @@
 
 #define delay(x) 				delay100us(x*10) // unit: 1msec
 
+// register shadow
+#define REG_NUM					0x20
+#define REG_VOICE_SELECT		0x0B
+#define REG_KEY_ON				0x0F
+#define REG_VOICE_TOP			0x0C // VoVol
+#define REG_VOICE_END			0x13 // FRAC
+#define VOICE_REG_NUM			(REG_VOICE_END - REG_VOICE_TOP + 1)
+#define VOICE_NUM				16
+#define FRAME_REG_MAX			8 // YMF825_WriteVoiceFrame
+
+// NSS of each chip on SPI1 (GPIOB). the reset (PB11) is shared by all chips.
+static const uint32_t _nss_pin_tbl[YMF825_MAX_DEVICE_NUM] = {
+	GPIO_PIN_12, GPIO_PIN_10, GPIO_PIN_8, GPIO_PIN_7
+};
+
+// register writes sent back to back, each as one address/data pair.
+typedef struct {
+	uint8_t reg[FRAME_REG_MAX][2];
+	uint8_t n;
+} reg_frame_t;
+
+#ifdef USE_YMF825_SPI_DMA
+// SPI1_TX is served by DMA0 channel 4.
+#define SPI_TX_DMA				DMA0
+#define SPI_TX_DMA_CH			DMA_CH4
+#define SPI_TX_DMA_IRQn			DMA0_Channel4_IRQn
+
+#ifndef YMF825_SPI_TX_QUEUE_SIZE
+#define YMF825_SPI_TX_QUEUE_SIZE	32 // power of 2
+#endif
+
+// one transaction is sent in one NSS cycle.
+// short ones are copied into data, long ones (tone burst) are sent from the buffer of the caller.
+typedef struct {
+	const uint8_t *ptr;
+	uint16_t size;
+	uint8_t data[2];
+	uint32_t nss;	// NSS pins of the chips to be written
+} spi_tx_t;
+
+static spi_tx_t _spi_tx_queue[YMF825_SPI_TX_QUEUE_SIZE];
+static volatile uint32_t _spi_tx_head;	// written by the main loop
+static volatile uint32_t _spi_tx_tail;	// written by the dma interrupt
+static volatile uint8_t  _spi_tx_busy;
+static volatile YMF825_SpiDmaStat_t _spi_dma_stat;
+static void (*_spi_tx_complete_callback)(void);
+#endif
+
 static uint8_t tone_data_tail[4] ={
 	0x80,0x03,0x81,0x80,
 };
 
 static spi_parameter_struct spi_init_struct;
 
-static void set_ss_low(void);
-static void set_ss_high(void);
+typedef enum {
+	TONE_UPLOAD_IDLE = 0,
+	TONE_UPLOAD_RESET,		// 0x08 = 0xF6 written, waiting 1 msec.
+} tone_upload_state_t;
+
+// tone parameter upload requested by YMF825_RequestToneParameter.
+static struct {
+	tone_upload_state_t state;
+	uint8_t pending;
+	uint8_t block_num;
+	uint8_t (*tone_matrix)[30];
+	uint32_t timer_mark;
+	YMF825_ToneUploadStat_t stat;
+	// 0x07, header, tone data and tail in one burst.
+	uint8_t burst[2 + 16*30 + sizeof(tone_data_tail)];
+} _tone_upload;
+
+// one for each chip. the values latched in the chip are held, the registers 0x0C-0x13 for each voice.
+typedef struct {
+	uint32_t nss_pin;
+	uint8_t  reg_shadow[REG_NUM];
+	uint32_t reg_valid;
+	uint8_t  voice_shadow[VOICE_NUM][VOICE_REG_NUM];
+	uint8_t  voice_valid[VOICE_NUM];
+} ymf825_device_t;
+
+static ymf825_device_t _device[YMF825_DEVICE_NUM];
+static ymf825_device_t *_dev = &_device[0]; // selected by YMF825_SelectDevice
+static uint32_t _all_nss_pins;
+static YMF825_ShadowStat_t _shadow_stat;
+
+static void set_ss_low(uint32_t nss);
+static void set_ss_high(uint32_t nss);
 static void set_rst_low(void);
 static void set_rst_high(void);
 static void setup(void);
+static void if_write_raw(uint32_t nss, uint8_t addr, const uint8_t* data, uint16_t size);
+static void broadcast_s_write(uint8_t addr, uint8_t data);
+static void shadow_invalidate(ymf825_device_t *dev);
+static void shadow_invalidate_all(void);
+static void reg_write(uint8_t addr, uint8_t data);
+static void reg_write2(uint8_t addr, uint8_t data0, uint8_t data1);
+static void frame_add(reg_frame_t *frame, uint8_t addr, uint8_t data);
+static void frame_add2(reg_frame_t *frame, uint8_t addr, uint8_t data0, uint8_t data1);
+static void frame_send(const reg_frame_t *frame);
+#ifdef USE_YMF825_SPI_DMA
+static void spi_dma_init(void);
+static void spi_dma_start(void);
+static void spi_dma_enqueue(const uint8_t *data, uint16_t size, uint32_t nss);
+#endif
+static void spi_dma_flush(void);
+static void tone_burst_send(uint8_t tone_matrix[][30], uint8_t block_num);
 
 static inline int32_t spi_transmit(const uint8_t *data, uint16_t size, uint16_t timeout_100us)
 {
@@ -132,6 +232,22 @@ static inline int32_t spi_receive(uint8_t *outbuf, uint16_t size, uint16_t timeo
 
 int32_t YMF825_Init(void) {
 
+	uint32_t i = 0;
+
+	// called again on every switch of the sound driver.
+	// let the frames and the tone burst in flight finish before the SPI is reset.
+	spi_dma_flush();
+
+	_all_nss_pins = 0;
+	for ( i = 0; i < YMF825_DEVICE_NUM; i++ ) {
+		_device[i].nss_pin = _nss_pin_tbl[i];
+		_all_nss_pins |= _nss_pin_tbl[i];
+	}
+	_dev = &_device[0];
+	shadow_invalidate_all();
+	_tone_upload.state = TONE_UPLOAD_IDLE;
+	_tone_upload.pending = 0;
+
 	/* deinitilize SPI and the parameters */
 	spi_i2s_deinit(SPI1);
 	spi_struct_para_init(&spi_init_struct);
@@ -146,10 +262,14 @@ int32_t YMF825_Init(void) {
 	spi_init_struct.endian					= SPI_ENDIAN_MSB;
 	spi_init(SPI1, &spi_init_struct);
 	spi_enable(SPI1);
+#ifdef USE_YMF825_SPI_DMA
+	spi_dma_init();
+#endif
 
-	set_ss_high();
+	set_ss_high(_all_nss_pins);
 	set_rst_low();
 
+	// the chips are set up together.
 	setup();
 
 	return 0;
@@ -157,15 +277,20 @@ int32_t YMF825_Init(void) {
 
 void YMF825_DeInit(void) {
 
+	spi_dma_flush();
+#ifdef USE_YMF825_SPI_DMA
+	eclic_irq_disable(SPI_TX_DMA_IRQn);
+	dma_channel_disable(SPI_TX_DMA, SPI_TX_DMA_CH);
+	spi_dma_disable(SPI1, SPI_DMA_TRANSMIT);
+#endif
 	spi_disable(SPI1);
 }
 
+// raw register access of the selected chip (hex mode). the shadow is not trusted afterwards.
 void if_write(uint8_t addr, const uint8_t* data, uint16_t size){
 
-	set_ss_low();
-	spi_transmit(&addr, 1, SPI_TRANSMIT_TIMEOUT);
-	spi_transmit(data, size, SPI_TRANSMIT_TIMEOUT);
-	set_ss_high();	
+	shadow_invalidate(_dev);
+	if_write_raw(_dev->nss_pin, addr, data, size);
 }
 
 void if_s_write(uint8_t addr,uint8_t data){
@@ -178,28 +303,53 @@ uint8_t if_s_read(uint8_t addr){
 	uint8_t rcv = 0;
 	uint8_t read_addr = addr|0x80;
 
-	set_ss_low();
+	spi_dma_flush();
+	set_ss_low(_dev->nss_pin);
 	spi_transmit(&read_addr, 1, SPI_TRANSMIT_TIMEOUT);
 	spi_receive(&rcv, 1, SPI_RECEIVE_TIMEOUT);
-	set_ss_high();
+	set_ss_high(_dev->nss_pin);
 
 	return rcv;	
 }
 
 
+// the following register writes go to the chip. 0 after YMF825_Init.
+void YMF825_SelectDevice(uint8_t device) {
+
+	if ( device < YMF825_DEVICE_NUM ) {
+		_dev = &_device[device];
+	}
+}
+
+uint8_t YMF825_GetDeviceNum(void) {
+
+	return YMF825_DEVICE_NUM;
+}
+
+uint32_t YMF825_GetNssPins(void) {
+
+	uint32_t nss = 0;
+	uint32_t i = 0;
+
+	for ( i = 0; i < YMF825_DEVICE_NUM; i++ ) {
+		nss |= _nss_pin_tbl[i];
+	}
+	return nss;
+}
+
 void YMF825_SelectChannel(uint8_t ch) {
 
-	if_s_write(0x0B, (ch&0x0F));
+	reg_write(0x0B, (ch&0x0F));
 }
 
 void YMF825_ChangeVoVol(uint8_t VoVol) {
 
-	if_s_write(0x0C, ((VoVol&0x1F) << 2));
+	reg_write(0x0C, ((VoVol&0x1F) << 2));
 }
 
 void YMF825_ChangeChVol(uint8_t ChVol) {
 
-	if_s_write(0x10, ((ChVol&0x1F) << 2));
+	reg_write(0x10, ((ChVol&0x1F) << 2));
 }
 
 void YMF825_SelectNoteNumber(uint16_t fnum, uint16_t block) {
@@ -207,29 +357,114 @@ void YMF825_SelectNoteNumber(uint16_t fnum, uint16_t block) {
 	uint8_t dat[2] = {0x00, 0x00};
 	dat[0] = ((fnum & 0x380) >> 4) | (block&0x07);
 	dat[1] = fnum & 0x7F;
-	if_s_write(0x0D, dat[0]);
-	if_s_write(0x0E, dat[1]);
+	reg_write2(0x0D, dat[0], dat[1]);
 }
 
 void YMF825_KeyOn(uint8_t tone_num) {
 
-	if_s_write(0x0F, (0x40|(tone_num&0x0F)));
+	reg_write(0x0F, (0x40|(tone_num&0x0F)));
 }
 
 void YMF825_KeyOff(uint8_t tone_num) {
 
-	if_s_write(0x0F, (0x00|(tone_num&0x0F)));
+	reg_write(0x0F, (0x00|(tone_num&0x0F)));
 }
 
 void YMF825_ChangeMASTER_VOL(uint8_t master_vol) {
 
-	if_s_write( 0x19, ((master_vol&0x3F) << 2) );
+	reg_write( 0x19, ((master_vol&0x3F) << 2) );
 }
 
 void YMF825_ChangePitch(uint16_t INT, uint16_t FRAC) {
 
-	if_s_write(0x12, (INT<<3) | ((FRAC>>6)&0x07));
-	if_s_write(0x13, (FRAC&0x3F)<<1);
+	reg_write2(0x12, (INT<<3) | ((FRAC>>6)&0x07), (FRAC&0x3F)<<1);
+}
+
+void YMF825_WriteVoiceFrame(const YMF825_VoiceFrame_t *voice_frame) {
+
+	reg_frame_t frame;
+
+	frame.n = 0;
+	frame_add(&frame, 0x0B, (voice_frame->voice&0x0F));
+	frame_add(&frame, 0x0C, ((voice_frame->VoVol&0x1F) << 2));
+	frame_add2(&frame, 0x0D,
+		((voice_frame->fnum & 0x380) >> 4) | (voice_frame->block&0x07),
+		voice_frame->fnum & 0x7F);
+	frame_add(&frame, 0x10, ((voice_frame->ChVol&0x1F) << 2));
+	frame_add2(&frame, 0x12,
+		(voice_frame->INT<<3) | ((voice_frame->FRAC>>6)&0x07),
+		(voice_frame->FRAC&0x3F)<<1);
+	frame_add(&frame, 0x0F, (0x40|(voice_frame->tone_num&0x0F)));
+	frame_send(&frame);
+}
+
+void YMF825_KeyOffVoice(uint8_t voice, uint8_t tone_num) {
+
+	reg_frame_t frame;
+
+	frame.n = 0;
+	frame_add(&frame, 0x0B, (voice&0x0F));
+	frame_add(&frame, 0x0F, (0x00|(tone_num&0x0F)));
+	frame_send(&frame);
+}
+
+#ifdef USE_YMF825_SPI_DMA
+void YMF825_GetSpiDmaStat(YMF825_SpiDmaStat_t *out) {
+
+	out->complete_count = _spi_dma_stat.complete_count;
+	out->underrun_count = _spi_dma_stat.underrun_count;
+	out->queue_full_count = _spi_dma_stat.queue_full_count;
+	out->timeout_count = _spi_dma_stat.timeout_count;
+}
+
+void YMF825_SetSpiTxCompleteCallback(void (*callback)(void)) {
+
+	_spi_tx_complete_callback = callback;
+}
+
+// whether queued transactions are left. 0 in the complete callback of the last one.
+uint8_t YMF825_IsSpiTxBusy(void) {
+
+	return ( _spi_tx_head != _spi_tx_tail ) ? 1 : 0;
+}
+
+// DMA0 channel 4 interrupt. called from DMA0_Channel4_IRQHandler.
+void ymf825_spi_dma_irq(void) {
+
+	if ( dma_interrupt_flag_get(SPI_TX_DMA, SPI_TX_DMA_CH, DMA_INT_FLAG_FTF) ) {
+
+		dma_interrupt_flag_clear(SPI_TX_DMA, SPI_TX_DMA_CH, DMA_INT_FLAG_G);
+
+		// the last byte has been moved to the SPI but may be still shifted out.
+		while(!(SPI_STAT(SPI1) & SPI_STAT_TBE));
+		while(SPI_STAT(SPI1) & SPI_STAT_TRANS);
+		set_ss_high(_spi_tx_queue[_spi_tx_tail & (YMF825_SPI_TX_QUEUE_SIZE-1)].nss);
+
+		_spi_tx_tail++;
+		_spi_dma_stat.complete_count++;
+		if ( _spi_tx_complete_callback ) {
+			_spi_tx_complete_callback();
+		}
+
+		if ( _spi_tx_head != _spi_tx_tail ) {
+			spi_dma_start();
+		}
+		else {
+			_spi_tx_busy = 0;
+		}
+	}
+}
+#endif
+
+void YMF825_GetShadowStat(YMF825_ShadowStat_t *out) {
+
+	*out = _shadow_stat;
+}
+
+void YMF825_ResetShadowStat(void) {
+
+	_shadow_stat.written_bytes = 0;
+	_shadow_stat.saved_bytes = 0;
 }
 
 void YMF825_SetToneParameter(uint8_t tone_matrix[16][30]) {
@@ -238,17 +473,17 @@ void YMF825_SetToneParameter(uint8_t tone_matrix[16][30]) {
 	uint8_t addr = 0x07;
 	int32_t i = 0;
 
-	if_s_write( 0x08, 0xF6 );
+	broadcast_s_write( 0x08, 0xF6 );
 	delay(1);
-	if_s_write( 0x08, 0x00 );
-	set_ss_low();
+	broadcast_s_write( 0x08, 0x00 );
+	set_ss_low(_all_nss_pins);
 	spi_transmit(&addr, 1, SPI_TRANSMIT_TIMEOUT);
 	spi_transmit(&tone_data_head, 1, SPI_TRANSMIT_TIMEOUT);
 	for ( i = 0; i < 16; i++ ) {
 		spi_transmit(tone_matrix[i], 30, SPI_TRANSMIT_TIMEOUT);
 	}
 	spi_transmit(&tone_data_tail[0], sizeof(tone_data_tail), SPI_TRANSMIT_TIMEOUT);
-	set_ss_high();	
+	set_ss_high(_all_nss_pins);
 
 }
 
@@ -258,28 +493,382 @@ void YMF825_SetToneParameterEx(uint8_t tone_matrix[][30], uint8_t block_num) {
 	int32_t i = 0;
 	uint8_t tone_data_head = 0x80|block_num;
 
-	if_s_write( 0x08, 0xF6 );
+	broadcast_s_write( 0x08, 0xF6 );
 	delay(1);
-	if_s_write( 0x08, 0x00 );
-	set_ss_low();
+	broadcast_s_write( 0x08, 0x00 );
+	set_ss_low(_all_nss_pins);
 	spi_transmit(&addr, 1, SPI_TRANSMIT_TIMEOUT);
 	spi_transmit(&tone_data_head, sizeof(tone_data_head), SPI_TRANSMIT_TIMEOUT);
 	for ( i = 0; i < block_num; i++ ) {
 		spi_transmit(tone_matrix[i], 30, SPI_TRANSMIT_TIMEOUT);
 	}
 	spi_transmit(&tone_data_tail[0], sizeof(tone_data_tail), SPI_TRANSMIT_TIMEOUT);
-	set_ss_high();	
+	set_ss_high(_all_nss_pins);
+
+}
+
+// the upload starts on the next YMF825_Task. the table is read when the data is sent,
+// so the requests made until then are merged into one upload.
+void YMF825_RequestToneParameter(uint8_t tone_matrix[][30], uint8_t block_num) {
+
+	if ( _tone_upload.pending && ( _tone_upload.tone_matrix == tone_matrix ) ) {
+		if ( _tone_upload.block_num < block_num ) {
+			_tone_upload.block_num = block_num;
+		}
+		_tone_upload.stat.merge_count++;
+		return;
+	}
+	if ( _tone_upload.pending ) {
+		// another table replaces the pending one.
+		_tone_upload.stat.merge_count++;
+	}
+	_tone_upload.tone_matrix = tone_matrix;
+	_tone_upload.block_num = block_num;
+	_tone_upload.pending = 1;
+}
+
+uint8_t YMF825_IsToneUploadBusy(void) {
+
+	return _tone_upload.pending;
+}
+
+// called from the main loop.
+void YMF825_Task(void) {
+
+	switch ( _tone_upload.state ) {
+
+		case TONE_UPLOAD_IDLE:
+			if ( _tone_upload.pending ) {
+				broadcast_s_write( 0x08, 0xF6 );
+				_tone_upload.timer_mark = FREERUN_COUNTER_100US;
+				_tone_upload.state = TONE_UPLOAD_RESET;
+			}
+			break;
+
+		case TONE_UPLOAD_RESET:
+			if ( (FREERUN_COUNTER_100US - _tone_upload.timer_mark) >= 10 ) {
+				broadcast_s_write( 0x08, 0x00 );
+				tone_burst_send(_tone_upload.tone_matrix, _tone_upload.block_num);
+				_tone_upload.pending = 0;
+				_tone_upload.state = TONE_UPLOAD_IDLE;
+				_tone_upload.stat.upload_count++;
+			}
+			break;
+
+		default:
+			_tone_upload.state = TONE_UPLOAD_IDLE;
+			break;
+	}
+}
+
+void YMF825_GetToneUploadStat(YMF825_ToneUploadStat_t *out) {
+
+	*out = _tone_upload.stat;
+}
+
+static void tone_burst_send(uint8_t tone_matrix[][30], uint8_t block_num) {
+
+	uint8_t *p = _tone_upload.burst;
+	uint32_t i = 0;
+
+	*p++ = 0x07;
+	*p++ = 0x80|block_num;
+	for ( i = 0; i < block_num; i++ ) {
+		memcpy(p, tone_matrix[i], 30);
+		p += 30;
+	}
+	memcpy(p, tone_data_tail, sizeof(tone_data_tail));
+	p += sizeof(tone_data_tail);
+
+#ifdef USE_YMF825_SPI_DMA
+	// sent by the dma. the next polled access (the next upload too) waits until it is done.
+	spi_dma_enqueue(_tone_upload.burst, (uint16_t)(p - _tone_upload.burst), _all_nss_pins);
+#else
+	set_ss_low(_all_nss_pins);
+	spi_transmit(_tone_upload.burst, (uint16_t)(p - _tone_upload.burst), SPI_TRANSMIT_TIMEOUT);
+	set_ss_high(_all_nss_pins);
+#endif
+}
+
+static void if_write_raw(uint32_t nss, uint8_t addr, const uint8_t* data, uint16_t size) {
+
+	spi_dma_flush();
+	set_ss_low(nss);
+	spi_transmit(&addr, 1, SPI_TRANSMIT_TIMEOUT);
+	spi_transmit(data, size, SPI_TRANSMIT_TIMEOUT);
+	set_ss_high(nss);
+}
+
+// the bus is write only while NSS is low, so all chips take the same write at once.
+static void broadcast_s_write(uint8_t addr, uint8_t data) {
+
+	shadow_invalidate_all();
+	if_write_raw(_all_nss_pins, addr, &data, 1);
+}
+
+static void shadow_invalidate(ymf825_device_t *dev) {
+
+	uint32_t i = 0;
+
+	dev->reg_valid = 0;
+	for ( i = 0; i < VOICE_NUM; i++ ) {
+		dev->voice_valid[i] = 0;
+	}
+}
+
+static void shadow_invalidate_all(void) {
+
+	uint32_t i = 0;
+
+	for ( i = 0; i < YMF825_DEVICE_NUM; i++ ) {
+		shadow_invalidate(&_device[i]);
+	}
+}
+
+// returns the shadow of the register, or NULL if it is not held (per-voice register with unknown voice).
+static uint8_t *shadow_entry(uint8_t addr, uint32_t *valid_bit, uint8_t **valid) {
+
+	uint8_t voice = 0;
+
+	if ( ( REG_VOICE_TOP <= addr ) && ( addr <= REG_VOICE_END ) ) {
+		if ( ( _dev->reg_valid & (1UL << REG_VOICE_SELECT) ) == 0 ) {
+			return NULL;
+		}
+		voice = _dev->reg_shadow[REG_VOICE_SELECT] & 0x0F;
+		*valid = &_dev->voice_valid[voice];
+		*valid_bit = 1UL << (addr - REG_VOICE_TOP);
+		return &_dev->voice_shadow[voice][addr - REG_VOICE_TOP];
+	}
+	else if ( addr < REG_NUM ) {
+		*valid = NULL;
+		*valid_bit = 1UL << addr;
+		return &_dev->reg_shadow[addr];
+	}
+	else {
+		return NULL;
+	}
+}
+
+static int shadow_hit(uint8_t addr, uint8_t data) {
+
+	uint32_t valid_bit = 0;
+	uint8_t *valid = NULL;
+	uint8_t *entry = shadow_entry(addr, &valid_bit, &valid);
+
+	if ( ( entry == NULL ) || ( addr == REG_KEY_ON ) ) {
+		// key on/off always has an effect.
+		return 0;
+	}
+	if ( valid != NULL ) {
+		return ( ( *valid & valid_bit ) != 0 ) && ( *entry == data );
+	}
+	return ( ( _dev->reg_valid & valid_bit ) != 0 ) && ( *entry == data );
+}
+
+static void shadow_update(uint8_t addr, uint8_t data) {
+
+	uint32_t valid_bit = 0;
+	uint8_t *valid = NULL;
+	uint8_t *entry = shadow_entry(addr, &valid_bit, &valid);
+
+	if ( entry != NULL ) {
+		*entry = data;
+		if ( valid != NULL ) {
+			*valid |= valid_bit;
+		}
+		else {
+			_dev->reg_valid |= valid_bit;
+		}
+	}
+}
+
+// register write through the shadow. a value already latched is not sent again.
+static void frame_add(reg_frame_t *frame, uint8_t addr, uint8_t data) {
+
+	if ( shadow_hit(addr, data) ) {
+		_shadow_stat.saved_bytes += 2;
+		return;
+	}
+	frame->reg[frame->n][0] = addr;
+	frame->reg[frame->n][1] = data;
+	frame->n++;
+	shadow_update(addr, data);
+	_shadow_stat.written_bytes += 2;
+}
+
+// a register pair which makes one value (FNUM, INT/FRAC) is written together if either changed.
+static void frame_add2(reg_frame_t *frame, uint8_t addr, uint8_t data0, uint8_t data1) {
+
+	if ( shadow_hit(addr, data0) && shadow_hit(addr + 1, data1) ) {
+		_shadow_stat.saved_bytes += 4;
+		return;
+	}
+	frame->reg[frame->n][0] = addr;
+	frame->reg[frame->n][1] = data0;
+	frame->n++;
+	shadow_update(addr, data0);
+	frame->reg[frame->n][0] = addr + 1;
+	frame->reg[frame->n][1] = data1;
+	frame->n++;
+	shadow_update(addr + 1, data1);
+	_shadow_stat.written_bytes += 4;
+}
+
+// the chip latches one register per NSS cycle (sequential writes are only for 0x07),
+// so each pair gets its own NSS pulse, with nothing else in between.
+static void frame_send(const reg_frame_t *frame) {
+
+	uint8_t i = 0;
+
+	for ( i = 0; i < frame->n; i++ ) {
+#ifdef USE_YMF825_SPI_DMA
+		spi_dma_enqueue(frame->reg[i], 2, _dev->nss_pin);
+#else
+		set_ss_low(_dev->nss_pin);
+		spi_transmit(frame->reg[i], 2, SPI_TRANSMIT_TIMEOUT);
+		set_ss_high(_dev->nss_pin);
+#endif
+	}
+}
+
+#ifdef USE_YMF825_SPI_DMA
+static void spi_dma_init(void) {
+
+	dma_parameter_struct dma_init_struct;
+
+	_spi_tx_head = 0;
+	_spi_tx_tail = 0;
+	_spi_tx_busy = 0;
+
+	dma_deinit(SPI_TX_DMA, SPI_TX_DMA_CH);
+	dma_struct_para_init(&dma_init_struct);
+	dma_init_struct.periph_addr		= (uint32_t)&SPI_DATA(SPI1);
+	dma_init_struct.periph_width	= DMA_PERIPHERAL_WIDTH_8BIT;
+	dma_init_struct.periph_inc		= DMA_PERIPH_INCREASE_DISABLE;
+	dma_init_struct.memory_addr		= (uint32_t)_spi_tx_queue[0].data;
+	dma_init_struct.memory_width	= DMA_MEMORY_WIDTH_8BIT;
+	dma_init_struct.memory_inc		= DMA_MEMORY_INCREASE_ENABLE;
+	dma_init_struct.number			= 0;
+	dma_init_struct.priority		= DMA_PRIORITY_HIGH;
+	dma_init_struct.direction		= DMA_MEMORY_TO_PERIPHERAL;
+	dma_init(SPI_TX_DMA, SPI_TX_DMA_CH, &dma_init_struct);
+	dma_circulation_disable(SPI_TX_DMA, SPI_TX_DMA_CH);
+	dma_memory_to_memory_disable(SPI_TX_DMA, SPI_TX_DMA_CH);
+	dma_interrupt_enable(SPI_TX_DMA, SPI_TX_DMA_CH, DMA_INT_FTF);
+
+	spi_dma_enable(SPI1, SPI_DMA_TRANSMIT);
+	eclic_irq_enable(SPI_TX_DMA_IRQn, 2, 0);
+}
+
+// start the transaction at the tail. the dma has to be idle.
+static void spi_dma_start(void) {
+
+	spi_tx_t *tx = &_spi_tx_queue[_spi_tx_tail & (YMF825_SPI_TX_QUEUE_SIZE-1)];
+
+	_spi_tx_busy = 1;
+	set_ss_low(tx->nss);
+	dma_channel_disable(SPI_TX_DMA, SPI_TX_DMA_CH);
+	dma_memory_address_config(SPI_TX_DMA, SPI_TX_DMA_CH, (uint32_t)tx->ptr);
+	dma_transfer_number_config(SPI_TX_DMA, SPI_TX_DMA_CH, tx->size);
+	dma_channel_enable(SPI_TX_DMA, SPI_TX_DMA_CH);
+}
+
+static void spi_dma_enqueue(const uint8_t *data, uint16_t size, uint32_t nss) {
+
+	uint32_t timer_mark = FREERUN_COUNTER_100US;
+	spi_tx_t *tx = (spi_tx_t *)0;
+	uint16_t i = 0;
+
+	if ( ( _spi_tx_head - _spi_tx_tail ) >= YMF825_SPI_TX_QUEUE_SIZE ) {
+		_spi_dma_stat.queue_full_count++;
+		while ( ( _spi_tx_head - _spi_tx_tail ) >= YMF825_SPI_TX_QUEUE_SIZE ) {
+			if ( (FREERUN_COUNTER_100US - timer_mark)>= SPI_TRANSMIT_TIMEOUT ) {
+				_spi_dma_stat.timeout_count++;
+				// the frame is dropped but the shadow already holds it.
+				for ( i = 0; i < YMF825_DEVICE_NUM; i++ ) {
+					if ( _device[i].nss_pin & nss ) {
+						shadow_invalidate(&_device[i]);
+					}
+				}
+				return;
+			}
+		}
+	}
+
+	tx = &_spi_tx_queue[_spi_tx_head & (YMF825_SPI_TX_QUEUE_SIZE-1)];
+	if ( size <= sizeof(tx->data) ) {
+		for ( i = 0; i < size; i++ ) {
+			tx->data[i] = data[i];
+		}
+		tx->ptr = tx->data;
+	}
+	else {
+		tx->ptr = data;
+	}
+	tx->size = size;
+	tx->nss = nss;
+	// the entry has to be written before the dma interrupt can see it.
+	__asm__ volatile ("" ::: "memory");
+	_spi_tx_head++;
+
+	// entry critical section
+	eclic_global_interrupt_disable();
+	if ( !_spi_tx_busy ) {
+		// the bus has been idle. the frames are built slower than they are sent.
+		_spi_dma_stat.underrun_count++;
+		spi_dma_start();
+	}
+	// leave critical section
+	eclic_global_interrupt_enable();
+}
+#endif
+
+// wait until the queued transactions are sent, before the polled access.
+static void spi_dma_flush(void) {
+#ifdef USE_YMF825_SPI_DMA
+	uint32_t timer_mark = FREERUN_COUNTER_100US;
+	volatile uint8_t dummy = 0;
+
+	while ( _spi_tx_busy ) {
+		if ( (FREERUN_COUNTER_100US - timer_mark)>= SPI_TRANSMIT_TIMEOUT ) {
+			_spi_dma_stat.timeout_count++;
+			break;
+		}
+	}
+
+	// clear the overrun left by the transmit only transfers.
+	dummy = SPI_DATA(SPI1);
+	dummy = SPI_STAT(SPI1);
+	(void)dummy;
+#endif
+}
+
+static void reg_write(uint8_t addr, uint8_t data) {
+
+	reg_frame_t frame;
+
+	frame.n = 0;
+	frame_add(&frame, addr, data);
+	frame_send(&frame);
+}
+
+static void reg_write2(uint8_t addr, uint8_t data0, uint8_t data1) {
+
+	reg_frame_t frame;
 
+	frame.n = 0;
+	frame_add2(&frame, addr, data0, data1);
+	frame_send(&frame);
 }
 
-static void set_ss_low(void) {
+static void set_ss_low(uint32_t nss) {
 
-	gpio_bit_reset(GPIOB, GPIO_PIN_12);
+	gpio_bit_reset(GPIOB, nss);
 }
 
-static void set_ss_high(void) {
+static void set_ss_high(uint32_t nss) {
 
-	gpio_bit_set(GPIOB, GPIO_PIN_12);
+	gpio_bit_set(GPIOB, nss);
 }
 
 static void set_rst_low(void) {
@@ -296,32 +885,32 @@ static void setup(void) {
 	set_rst_low();
 	delay(1);
 	set_rst_high();
-	if_s_write( 0x1D, OUTPUT_power );
-	if_s_write( 0x02, 0x0E );
+	broadcast_s_write( 0x1D, OUTPUT_power );
+	broadcast_s_write( 0x02, 0x0E );
 	delay(1);
-	if_s_write( 0x00, 0x01 );//CLKEN
-	if_s_write( 0x01, 0x00 ); //AKRST
-	if_s_write( 0x1A, 0xA3 );
+	broadcast_s_write( 0x00, 0x01 );//CLKEN
+	broadcast_s_write( 0x01, 0x00 ); //AKRST
+	broadcast_s_write( 0x1A, 0xA3 );
 	delay(1);
-	if_s_write( 0x1A, 0x00 );
+	broadcast_s_write( 0x1A, 0x00 );
 	delay(30);
-	if_s_write( 0x02, 0x04 );//AP1,AP3
+	broadcast_s_write( 0x02, 0x04 );//AP1,AP3
 	delay(1);
-	if_s_write( 0x02, 0x00 );
+	broadcast_s_write( 0x02, 0x00 );
 	//add
-	if_s_write( 0x19, (40 << 2) );//MASTER VOL
-	if_s_write( 0x1B, 0x3F );//interpolation
-	if_s_write( 0x14, 0x00 );//interpolation
-	if_s_write( 0x03, 0x01 );//Analog Gain
+	broadcast_s_write( 0x19, (40 << 2) );//MASTER VOL
+	broadcast_s_write( 0x1B, 0x3F );//interpolation
+	broadcast_s_write( 0x14, 0x00 );//interpolation
+	broadcast_s_write( 0x03, 0x01 );//Analog Gain
 	
-	if_s_write( 0x08, 0xF6 );
+	broadcast_s_write( 0x08, 0xF6 );
 	delay(21);
-	if_s_write( 0x08, 0x00 );
-	if_s_write( 0x09, 0xF8 );
-	if_s_write( 0x0A, 0x00 );
+	broadcast_s_write( 0x08, 0x00 );
+	broadcast_s_write( 0x09, 0xF8 );
+	broadcast_s_write( 0x0A, 0x00 );
 	
-	if_s_write( 0x17, 0x40 );//MS_S
-	if_s_write( 0x18, 0x00 );
+	broadcast_s_write( 0x17, 0x40 );//MS_S
+	broadcast_s_write( 0x18, 0x00 );
 }
 
 void init_825(void) {
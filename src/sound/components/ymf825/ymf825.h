@@ -27,9 +27,50 @@
 #include <stdint.h>
 #include <stddef.h>
 
+// number of the chips on SPI1, each with its own NSS (see YMF825_GetNssPins).
+#define YMF825_MAX_DEVICE_NUM	4
+#ifndef YMF825_DEVICE_NUM
+#define YMF825_DEVICE_NUM		1
+#endif
+#if ( YMF825_DEVICE_NUM < 1 ) || ( YMF825_MAX_DEVICE_NUM < YMF825_DEVICE_NUM )
+#error "YMF825_DEVICE_NUM is out of range."
+#endif
+
+typedef struct {
+	uint32_t written_bytes;	// SPI bytes sent by the register writes of the YMF825_ API
+	uint32_t saved_bytes;	// SPI bytes dropped because the register already held the value
+} YMF825_ShadowStat_t;
+
+typedef struct {
+	uint32_t complete_count;	// transactions sent by the dma
+	uint32_t underrun_count;	// the dma went idle and was restarted by a new transaction
+	uint32_t queue_full_count;	// a new transaction waited for a free entry
+	uint32_t timeout_count;		// the dma did not proceed in time
+} YMF825_SpiDmaStat_t;
+
+typedef struct {
+	uint32_t upload_count;	// tone parameter uploads sent
+	uint32_t merge_count;	// requests merged into a pending upload
+} YMF825_ToneUploadStat_t;
+
+// everything needed to start a note on a voice.
+typedef struct {
+	uint8_t  voice;
+	uint8_t  VoVol;
+	uint8_t  ChVol;
+	uint8_t  tone_num;
+	uint16_t fnum;
+	uint16_t block;
+	uint16_t INT;
+	uint16_t FRAC;
+} YMF825_VoiceFrame_t;
+
 extern int32_t YMF825_Init(void);
 extern void YMF825_DeInit(void);
 
+extern void YMF825_SelectDevice(uint8_t device);
+extern uint8_t YMF825_GetDeviceNum(void);
+extern uint32_t YMF825_GetNssPins(void);
 extern void YMF825_SelectChannel(uint8_t ch);
 extern void YMF825_SelectNoteNumber(uint16_t fnum, uint16_t block);
 extern void YMF825_ChangeVoVol(uint8_t VoVol); 
@@ -40,6 +81,20 @@ extern void YMF825_KeyOn(uint8_t tone_num);
 extern void YMF825_KeyOff(uint8_t tone_num);
 extern void YMF825_SetToneParameter(uint8_t tone_matrix[16][30]);
 extern void YMF825_SetToneParameterEx(uint8_t tone_matrix[][30], uint8_t block_num);
+extern void YMF825_WriteVoiceFrame(const YMF825_VoiceFrame_t *voice_frame);
+extern void YMF825_KeyOffVoice(uint8_t voice, uint8_t tone_num);
+extern void YMF825_RequestToneParameter(uint8_t tone_matrix[][30], uint8_t block_num);
+extern uint8_t YMF825_IsToneUploadBusy(void);
+extern void YMF825_Task(void);
+extern void YMF825_GetToneUploadStat(YMF825_ToneUploadStat_t *out);
+extern void YMF825_GetShadowStat(YMF825_ShadowStat_t *out);
+#ifdef USE_YMF825_SPI_DMA
+extern void YMF825_GetSpiDmaStat(YMF825_SpiDmaStat_t *out);
+extern void YMF825_SetSpiTxCompleteCallback(void (*callback)(void));
+extern uint8_t YMF825_IsSpiTxBusy(void);
+extern void ymf825_spi_dma_irq(void);
+#endif
+extern void YMF825_ResetShadowStat(void);
 
 extern void if_write(uint8_t addr, const uint8_t* data, uint16_t size);
 extern void if_s_write(uint8_t addr,uint8_t data);
@@ -26,6 +26,9 @@
 #include <gd32vf103_spi.h>
 #include <gd32vf103_timer.h>
 #include <gd32vf103_gpio.h>
+#ifdef USE_YMZ294_BUS_QUEUE
+#include <gd32vf103_eclic.h>
+#endif
 
 #define YMZ294_WR_N       GPIO_PIN_0    // A0
 #define YMZ294_AO         GPIO_PIN_9    // B9
@@ -34,6 +37,44 @@
 
 static void setup_sound_clock(void);
 static void setup_com(void);
+static void bus_write(uint8_t addr, uint8_t data);
+
+// last value written to each register. the registers can not be read back.
+static uint8_t _reg_shadow[YMZ294_REG_NUM];
+static uint16_t _reg_valid; // bit n: _reg_shadow[n] holds the register value
+static ymz294_shadow_stat_t _shadow_stat;
+
+#ifdef USE_YMZ294_BUS_QUEUE
+// the bus is driven by the update interrupt of TIMER3, one byte per tick.
+// a tick has to be longer than one byte on SPI0 (8 bits at 96 MHz / 16 = 1.3 us).
+#define YMZ294_BUS_TIMER        TIMER3
+#define YMZ294_BUS_TIMER_IRQn   TIMER3_IRQn
+#define YMZ294_BUS_TICK_US      4
+#define YMZ294_BUS_TIMEOUT      100 // 10 ms
+
+// one entry for each register. a register is queued once and a later write
+// only replaces the pending data, so the queue can not overflow.
+#define YMZ294_BUS_QUEUE_SIZE   16
+
+typedef enum {
+	BUS_PHASE_IDLE = 0,
+	BUS_PHASE_ADDRESS,
+	BUS_PHASE_DATA,
+} bus_phase_t;
+
+static uint8_t _bus_queue[YMZ294_BUS_QUEUE_SIZE];	// register addresses in the order of the first write
+static uint8_t _bus_data[YMZ294_BUS_QUEUE_SIZE];	// the latest data of each pending register
+static volatile uint16_t _bus_pending;				// bit n: register n is in the queue
+static volatile uint32_t _bus_head;					// written by the main loop
+static volatile uint32_t _bus_tail;					// written by the timer interrupt
+static volatile bus_phase_t _bus_phase;
+static uint8_t _bus_cur_data;
+static volatile ymz294_bus_stat_t _bus_stat;
+static void (*_bus_idle_callback)(void);
+
+static void setup_bus_timer(void);
+static void bus_flush(void);
+#endif
 
 static inline void sn74hc164n_init(void)
 {
@@ -102,22 +143,84 @@ int32_t ymz294_init(void)
 	sn74hc164n_deinit();
 	sn74hc164n_init();
 
+	// the state of the chip is unknown until each register is written.
+	_reg_valid = 0;
+
     ymz294_write_disable();
 	ymz294_address_mode();
 
 	setup_sound_clock(); //  supply to 4 MHz clock to YMZ294
 	setup_com(); // setup communication processing
+#ifdef USE_YMZ294_BUS_QUEUE
+	setup_bus_timer(); // setup the queued bus writer
+#endif
 
 	return 0;
 }
 
 void ymz294_deinit(void)
 {
+#ifdef USE_YMZ294_BUS_QUEUE
+	bus_flush();
+	timer_interrupt_disable(YMZ294_BUS_TIMER, TIMER_INT_UP);
+	eclic_irq_disable(YMZ294_BUS_TIMER_IRQn);
+	timer_deinit(YMZ294_BUS_TIMER);
+#endif
 	spi_disable(SPI0);
 	timer_deinit(TIMER1);
 }
 
+// the write is dropped when the register already holds the value.
 int32_t ymz294_write(uint8_t addr, uint8_t data)
+{
+	if ( addr < YMZ294_REG_NUM )
+	{
+		if ( ( _reg_valid & (1U << addr) ) && ( _reg_shadow[addr] == data ) )
+		{
+			_shadow_stat.saved_count++;
+			return 0;
+		}
+		_reg_shadow[addr] = data;
+		_reg_valid |= (1U << addr);
+	}
+	_shadow_stat.write_count++;
+	bus_write(addr, data);
+
+	return 0;
+}
+
+// always written. writing the envelope shape (R13) restarts the envelope.
+int32_t ymz294_write_force(uint8_t addr, uint8_t data)
+{
+	if ( addr < YMZ294_REG_NUM )
+	{
+		_reg_shadow[addr] = data;
+		_reg_valid |= (1U << addr);
+	}
+	_shadow_stat.write_count++;
+	bus_write(addr, data);
+
+	return 0;
+}
+
+// the value last written. 0 if the register has not been written since ymz294_init.
+uint8_t ymz294_read_shadow(uint8_t addr)
+{
+	if ( ( addr < YMZ294_REG_NUM ) && ( _reg_valid & (1U << addr) ) )
+	{
+		return _reg_shadow[addr];
+	}
+	return 0;
+}
+
+void ymz294_get_shadow_stat(ymz294_shadow_stat_t *out)
+{
+	out->write_count = _shadow_stat.write_count;
+	out->saved_count = _shadow_stat.saved_count;
+}
+
+#ifndef USE_YMZ294_BUS_QUEUE
+static void bus_write(uint8_t addr, uint8_t data)
 {
 	// address
 	sn74hc164n_clear();
@@ -132,10 +235,160 @@ int32_t ymz294_write(uint8_t addr, uint8_t data)
 	ymz294_write_enable();
 	spi_transmit(data, 10);
 	ymz294_write_disable();
+}
+#else
+// clear the shift register and start shifting out one byte with /WR low.
+// the byte is latched by the YMZ294 when /WR goes high on the next tick.
+static inline void bus_shift_out(uint8_t data)
+{
+	sn74hc164n_clear();
+	ymz294_write_enable();
+	SPI_DATA(SPI0) = data;
+}
 
-	return 0;
+// take the register at the tail and put its address on the bus.
+static void bus_start(void)
+{
+	uint8_t addr = _bus_queue[_bus_tail & (YMZ294_BUS_QUEUE_SIZE-1)];
+
+	_bus_tail++;
+	_bus_pending &= ~(1U << addr);
+	_bus_cur_data = _bus_data[addr];
+	_bus_phase = BUS_PHASE_ADDRESS;
+	ymz294_address_mode();
+	bus_shift_out(addr);
 }
 
+// queue the write and return without waiting for the bus.
+static void bus_write(uint8_t addr, uint8_t data)
+{
+	addr &= (YMZ294_BUS_QUEUE_SIZE-1);
+
+	// entry critical section
+	eclic_global_interrupt_disable();
+	_bus_data[addr] = data;
+	if ( _bus_pending & (1U << addr) )
+	{// the register has not been sent yet. only the last value matters.
+		_bus_stat.coalesced_count++;
+	}
+	else
+	{
+		_bus_pending |= (1U << addr);
+		_bus_queue[_bus_head & (YMZ294_BUS_QUEUE_SIZE-1)] = addr;
+		_bus_head++;
+		if ( _bus_phase == BUS_PHASE_IDLE )
+		{
+			bus_start();
+			timer_counter_value_config(YMZ294_BUS_TIMER, 0);
+			timer_enable(YMZ294_BUS_TIMER);
+		}
+	}
+	// leave critical section
+	eclic_global_interrupt_enable();
+}
+
+// TIMER3 update interrupt. called from TIMER3_IRQHandler.
+void ymz294_bus_timer_irq(void)
+{
+	if ( timer_interrupt_flag_get(YMZ294_BUS_TIMER, TIMER_INT_FLAG_UP) )
+	{
+		timer_interrupt_flag_clear(YMZ294_BUS_TIMER, TIMER_INT_FLAG_UP);
+
+		if ( SPI_STAT(SPI0) & SPI_STAT_TRANS )
+		{// the byte is still shifted out. try again on the next tick.
+			return;
+		}
+		ymz294_write_disable();
+
+		switch ( _bus_phase )
+		{
+		case BUS_PHASE_ADDRESS:
+			_bus_phase = BUS_PHASE_DATA;
+			ymz294_data_mode();
+			bus_shift_out(_bus_cur_data);
+			break;
+		case BUS_PHASE_DATA:
+			_bus_stat.write_count++;
+			if ( _bus_head != _bus_tail )
+			{
+				bus_start();
+			}
+			else
+			{
+				_bus_phase = BUS_PHASE_IDLE;
+				timer_disable(YMZ294_BUS_TIMER);
+				if ( _bus_idle_callback )
+				{
+					_bus_idle_callback();
+				}
+			}
+			break;
+		default:
+			timer_disable(YMZ294_BUS_TIMER);
+			break;
+		}
+	}
+}
+
+void ymz294_get_bus_stat(ymz294_bus_stat_t *out)
+{
+	out->write_count = _bus_stat.write_count;
+	out->coalesced_count = _bus_stat.coalesced_count;
+}
+
+// whether queued writes are left. 0 in the idle callback.
+uint8_t ymz294_is_bus_busy(void)
+{
+	return ( _bus_phase != BUS_PHASE_IDLE ) ? 1 : 0;
+}
+
+// called from the interrupt when the last queued write has been sent.
+void ymz294_set_bus_idle_callback(void (*callback)(void))
+{
+	_bus_idle_callback = callback;
+}
+
+// wait until the queued writes are sent.
+static void bus_flush(void)
+{
+	uint32_t timer_mark = FREERUN_COUNTER_100US;
+	while ( _bus_phase != BUS_PHASE_IDLE )
+	{
+		if ( (FREERUN_COUNTER_100US - timer_mark)>= YMZ294_BUS_TIMEOUT )
+		{// timeout
+			break;
+		}
+	}
+}
+
+static void setup_bus_timer(void)
+{
+	timer_parameter_struct timer_initpara;
+
+	_bus_pending = 0;
+	_bus_head = 0;
+	_bus_tail = 0;
+	_bus_phase = BUS_PHASE_IDLE;
+
+	eclic_irq_enable(YMZ294_BUS_TIMER_IRQn, 2, 0);
+
+	timer_struct_para_init(&timer_initpara);
+	timer_initpara.clockdivision	 = TIMER_CKDIV_DIV1;
+	timer_initpara.prescaler		 = 95;// 96 MHz / 96 = 1 MHz
+	timer_initpara.alignedmode	   = TIMER_COUNTER_EDGE;
+	timer_initpara.counterdirection  = TIMER_COUNTER_UP;
+	timer_initpara.period			= YMZ294_BUS_TICK_US - 1;
+
+	timer_deinit(YMZ294_BUS_TIMER);
+	timer_init(YMZ294_BUS_TIMER, &timer_initpara);
+
+	timer_update_event_enable(YMZ294_BUS_TIMER);
+	timer_interrupt_enable(YMZ294_BUS_TIMER, TIMER_INT_UP);
+	timer_flag_clear(YMZ294_BUS_TIMER, TIMER_FLAG_UP);
+	timer_update_source_config(YMZ294_BUS_TIMER, TIMER_UPDATE_SRC_GLOBAL);
+	// started by ymz294_write
+}
+#endif
 
 // setup 4MHz clock source for YMZ294
 static void setup_sound_clock(void)
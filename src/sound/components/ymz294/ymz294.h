@@ -126,8 +126,31 @@
 +------+------+------+------+---------------------------------------------------+
 */
 
+#define YMZ294_REG_NUM  14 // R0-R13
+
+typedef struct {
+	uint32_t write_count;	// register writes passed to the bus
+	uint32_t saved_count;	// writes dropped because the register already held the value
+} ymz294_shadow_stat_t;
+
+#ifdef USE_YMZ294_BUS_QUEUE
+typedef struct {
+	uint32_t write_count;		// register writes sent on the bus
+	uint32_t coalesced_count;	// writes merged into a pending write of the same register
+} ymz294_bus_stat_t;
+#endif
+
 extern int32_t ymz294_init(void);
 extern void ymz294_deinit(void);
 extern int32_t ymz294_write(uint8_t addr, uint8_t data);
+extern int32_t ymz294_write_force(uint8_t addr, uint8_t data);
+extern uint8_t ymz294_read_shadow(uint8_t addr);
+extern void ymz294_get_shadow_stat(ymz294_shadow_stat_t *out);
+#ifdef USE_YMZ294_BUS_QUEUE
+extern void ymz294_get_bus_stat(ymz294_bus_stat_t *out);
+extern uint8_t ymz294_is_bus_busy(void);
+extern void ymz294_set_bus_idle_callback(void (*callback)(void));
+extern void ymz294_bus_timer_irq(void);
+#endif
 
 #endif//__YMZ294_H__
@@ -43,6 +43,11 @@ typedef struct _Parse_MIDI_FSM {
 MIDI_Handle_t *MIDI_Alloc(void);
 void MIDI_Free(MIDI_Handle_t *phMIDI);
 
+// number of MIDI bytes for each Code Index Number of the USB-MIDI event packet.
+static const uint8_t _usb_midi_cin_size_tbl[16] = {
+	0, 0, 2, 3, 3, 1, 2, 3, 3, 3, 3, 3, 2, 2, 3, 1
+};
+
 
 static inline Parse_MIDI_Message_Event_t _GetParseMIDIMessageEvent(uint8_t msg) {
 
@@ -84,9 +89,52 @@ static inline Parse_MIDI_Message_Event_t _GetParseMIDIMessageEvent(uint8_t msg)
 }
 
 
+// message types which have a callback. the dispatcher does not need to check NULL.
+static uint8_t _GetCallbackMask(const MIDI_Message_Callbacks_t *pcallbacks) {
+
+	const MIDI_ChannelVoiceMessage_t *pchvmsg = &pcallbacks->channel.voice_msg;
+	uint8_t mask = 0;
+
+	mask |= ( pchvmsg->pNoteOff != NULL ) ? MIDI_MSG_MASK_NOTE_OFF : 0;
+	mask |= ( pchvmsg->pNoteOn != NULL ) ? MIDI_MSG_MASK_NOTE_ON : 0;
+	mask |= ( pchvmsg->pPolyphonicKeyPressure != NULL ) ? MIDI_MSG_MASK_POLY_KEY_PRESSURE : 0;
+	mask |= ( pchvmsg->pControlChange != NULL ) ? MIDI_MSG_MASK_CONTROL_CHANGE : 0;
+	mask |= ( pchvmsg->pProgramChange != NULL ) ? MIDI_MSG_MASK_PROGRAM_CHANGE : 0;
+	mask |= ( pchvmsg->pChannelPressure != NULL ) ? MIDI_MSG_MASK_CHANNEL_PRESSURE : 0;
+	mask |= ( pchvmsg->pPitchBendChange != NULL ) ? MIDI_MSG_MASK_PITCH_BEND_CHANGE : 0;
+#if MAX_SYS_EX_BUF_SIZE > 0
+	mask |= ( pcallbacks->system.exclusive_msg.pSystemExclusive != NULL ) ? MIDI_MSG_MASK_SYSTEM_EXCLUSIVE : 0;
+#endif
+	mask |= ( pcallbacks->system.exclusive_msg.pSysExStart != NULL ) ? MIDI_MSG_MASK_SYSTEM_EXCLUSIVE : 0;
+	mask |= ( pcallbacks->system.exclusive_msg.pSysExData != NULL ) ? MIDI_MSG_MASK_SYSTEM_EXCLUSIVE : 0;
+	mask |= ( pcallbacks->system.exclusive_msg.pSysExEnd != NULL ) ? MIDI_MSG_MASK_SYSTEM_EXCLUSIVE : 0;
+
+	return mask;
+}
+
+// merge the filter and the masks of all sinks, so that a message no sink
+// receives is dropped before walking the sink list.
+static void _UpdateHandleMask(MIDI_Handle_t *phMIDI) {
+
+	uint8_t i = 0;
+	uint16_t ch_mask = 0;
+	uint8_t msg_mask = 0;
+
+	for ( i = 0; i < phMIDI->n_sink; i++ ) {
+		ch_mask |= phMIDI->sink[i].ch_mask;
+		msg_mask |= phMIDI->sink[i].msg_mask;
+	}
+
+	phMIDI->ch_mask = ch_mask & phMIDI->ch_filter;
+	phMIDI->msg_mask = msg_mask & phMIDI->msg_filter;
+}
+
 static void _StoreChannelMessageStatus(MIDI_Handle_t *phMIDI, uint8_t msg); 
 static void _StoreChannelMessageData(MIDI_Handle_t *phMIDI, uint8_t msg);
+static void _StartSystemExclusiveMessage(MIDI_Handle_t *phMIDI, uint8_t msg);
 static void _StoreSystemExclusiveMessage(MIDI_Handle_t *phMIDI, uint8_t msg);
+static void _PutSystemExclusiveData(MIDI_Handle_t *phMIDI, const uint8_t *dat, size_t len);
+static void _AbortSystemExclusiveMessage(MIDI_Handle_t *phMIDI);
 static void _ExecChannelMessage1(MIDI_Handle_t *phMIDI, uint8_t msg);
 static void _ExecChannelMessage2(MIDI_Handle_t *phMIDI, uint8_t msg);
 static void _ExecSystemExclusiveMessage(MIDI_Handle_t *phMIDI, uint8_t msg);
@@ -98,7 +146,7 @@ static const Parse_MIDI_FSM_t _midi_trans_state_tbl[NUM_OF_PARSE_MIDI_MESSAGE_ST
 		{PARSE_MIDI_CH_MSG_2_1, _StoreChannelMessageStatus}, // RCV_STS_CH_MSG_2
 		{PARSE_MIDI_IDLE, NULL}, // RCV_SYS_RT
 		{PARSE_MIDI_IDLE, NULL}, // RCV_DAT
-		{PARSE_MIDI_SYS_EX, _StoreSystemExclusiveMessage}, // RCV_SYS_EX_START
+		{PARSE_MIDI_SYS_EX, _StartSystemExclusiveMessage}, // RCV_SYS_EX_START
 		{PARSE_MIDI_IDLE, NULL}, // RCV_SYS_EX_EOX
 	},
 	/* CH_MSG_1 */
@@ -134,7 +182,7 @@ static const Parse_MIDI_FSM_t _midi_trans_state_tbl[NUM_OF_PARSE_MIDI_MESSAGE_ST
 		{PARSE_MIDI_CH_MSG_2_1, _StoreChannelMessageStatus}, // RCV_STS_CH_MSG_2
 		{PARSE_MIDI_IDLE, NULL}, // RCV_SYS_RT
 		{PARSE_MIDI_CH_MSG_RUNNING_1, _ExecChannelMessage1}, // RCV_DAT
-		{PARSE_MIDI_SYS_EX, NULL}, // RCV_SYS_EX_START
+		{PARSE_MIDI_SYS_EX, _StartSystemExclusiveMessage}, // RCV_SYS_EX_START
 		{PARSE_MIDI_IDLE, NULL}, // RCV_SYS_EX_EOX
 	},
 	/* CH_MSG_RUNNING_2 */
@@ -143,14 +191,14 @@ static const Parse_MIDI_FSM_t _midi_trans_state_tbl[NUM_OF_PARSE_MIDI_MESSAGE_ST
 		{PARSE_MIDI_CH_MSG_2_1, _StoreChannelMessageStatus}, // RCV_STS_CH_MSG_2
 		{PARSE_MIDI_IDLE, NULL}, // RCV_SYS_RT
 		{PARSE_MIDI_CH_MSG_2_2, _StoreChannelMessageData}, // RCV_DAT
-		{PARSE_MIDI_SYS_EX, NULL}, // RCV_SYS_EX_START
+		{PARSE_MIDI_SYS_EX, _StartSystemExclusiveMessage}, // RCV_SYS_EX_START
 		{PARSE_MIDI_IDLE, NULL}, // RCV_SYS_EX_EOX
 	},
 	/* PARSE_MIDI_SYS_EX */
 	{
 		{PARSE_MIDI_SYS_EX, _StoreSystemExclusiveMessage}, // RCV_STS_CH_MSG_1
 		{PARSE_MIDI_SYS_EX, _StoreSystemExclusiveMessage}, // RCV_STS_CH_MSG_2
-		{PARSE_MIDI_SYS_EX, _StoreSystemExclusiveMessage}, // RCV_SYS_RT
+		{PARSE_MIDI_SYS_EX, NULL}, // RCV_SYS_RT
 		{PARSE_MIDI_SYS_EX, _StoreSystemExclusiveMessage}, // RCV_DAT
 		{PARSE_MIDI_SYS_EX, _StoreSystemExclusiveMessage}, // RCV_SYS_EX_START
 		{PARSE_MIDI_IDLE, _ExecSystemExclusiveMessage}, // RCV_SYS_EX_EOX
@@ -164,18 +212,28 @@ MIDI_Handle_t *MIDI_Init(const MIDI_Message_Callbacks_t *pcallbacks ) {
 	phMIDI = MIDI_Alloc();
 
 	if ( phMIDI != NULL ) {
-		uint32_t i = 0;
 		phMIDI->chmsg_buf.msg0 = 0;
 		phMIDI->chmsg_buf.msg1 = 0;
 		phMIDI->chmsg_buf.msg2 = 0;
 		phMIDI->chmsg_buf.pad  = 0;
-		phMIDI->sysex_buf.len  = 0;
-		for ( i = 0; i < MAX_SYS_EX_BUF_SIZE; i++ ) {
-			phMIDI->sysex_buf.msg[i] = 0;
+#if MAX_SYS_EX_BUF_SIZE > 0
+		{
+			uint32_t i = 0;
+			phMIDI->sysex_buf.len  = 0;
+			for ( i = 0; i < MAX_SYS_EX_BUF_SIZE; i++ ) {
+				phMIDI->sysex_buf.msg[i] = 0;
+			}
 		}
+#endif
 
 		phMIDI->state = PARSE_MIDI_IDLE;
-		phMIDI->pcallback = pcallbacks;
+		phMIDI->n_sink = 0;
+		phMIDI->ch_filter = MIDI_CH_MASK_ALL;
+		phMIDI->msg_filter = MIDI_MSG_MASK_ALL;
+		_UpdateHandleMask(phMIDI);
+		if ( pcallbacks != NULL ) {
+			MIDI_AddSink(phMIDI, pcallbacks, MIDI_CH_MASK_ALL, MIDI_MSG_MASK_ALL);
+		}
 	}
 
 	return phMIDI;
@@ -188,13 +246,101 @@ void MIDI_DeInit( MIDI_Handle_t *phMIDI ) {
 	}
 }
 
+int32_t MIDI_AddSink(MIDI_Handle_t *phMIDI, const MIDI_Message_Callbacks_t *pcallbacks, uint16_t ch_mask, uint8_t msg_mask) {
+
+	MIDI_Sink_t *psink = NULL;
+
+	if ( ( pcallbacks == NULL ) || ( phMIDI->n_sink >= MAX_MIDI_SINK_NUM ) ) {
+		return -1;
+	}
+
+	psink = &phMIDI->sink[phMIDI->n_sink];
+	psink->pcallback = pcallbacks;
+	psink->ch_mask = ch_mask;
+	psink->msg_mask = msg_mask & _GetCallbackMask(pcallbacks);
+	phMIDI->n_sink++;
+	_UpdateHandleMask(phMIDI);
+
+	return 0;
+}
+
+int32_t MIDI_RemoveSink(MIDI_Handle_t *phMIDI, const MIDI_Message_Callbacks_t *pcallbacks) {
+
+	uint8_t i = 0;
+
+	for ( i = 0; i < phMIDI->n_sink; i++ ) {
+		if ( phMIDI->sink[i].pcallback == pcallbacks ) {
+			// keep the order of the remaining sinks.
+			for ( ; i + 1 < phMIDI->n_sink; i++ ) {
+				phMIDI->sink[i] = phMIDI->sink[i + 1];
+			}
+			phMIDI->n_sink--;
+			_UpdateHandleMask(phMIDI);
+			return 0;
+		}
+	}
+
+	return -1;
+}
+
+int32_t MIDI_SetSinkMask(MIDI_Handle_t *phMIDI, const MIDI_Message_Callbacks_t *pcallbacks, uint16_t ch_mask, uint8_t msg_mask) {
+
+	uint8_t i = 0;
+
+	for ( i = 0; i < phMIDI->n_sink; i++ ) {
+		if ( phMIDI->sink[i].pcallback == pcallbacks ) {
+			phMIDI->sink[i].ch_mask = ch_mask;
+			phMIDI->sink[i].msg_mask = msg_mask & _GetCallbackMask(pcallbacks);
+			_UpdateHandleMask(phMIDI);
+			return 0;
+		}
+	}
+
+	return -1;
+}
+
+void MIDI_SetFilter(MIDI_Handle_t *phMIDI, uint16_t ch_mask, uint8_t msg_mask) {
+
+	phMIDI->ch_filter = ch_mask;
+	phMIDI->msg_filter = msg_mask;
+	_UpdateHandleMask(phMIDI);
+}
+
+void MIDI_GetFilter(const MIDI_Handle_t *phMIDI, uint16_t *ch_mask, uint8_t *msg_mask) {
+
+	*ch_mask = phMIDI->ch_filter;
+	*msg_mask = phMIDI->msg_filter;
+}
+
 int32_t MIDI_Play(MIDI_Handle_t *phMIDI, const uint8_t *midi_msg, size_t len) {
 
 	uint32_t i = 0;
+	size_t n = 0;
 	Parse_MIDI_Message_Event_t event = PARSE_MIDI_EVENT_RCV_STS_CH_MSG_1;
 	const Parse_MIDI_FSM_t *pfsm = NULL;
 	
 	for ( i = 0; i < len; i++ )	{
+
+		if ( phMIDI->state == PARSE_MIDI_SYS_EX ) {
+			if ( (midi_msg[i] & 0x80) == 0 ) {
+				// pass the run of system exclusive data bytes at once.
+				for ( n = 1; ( i + n < len ) && ( (midi_msg[i + n] & 0x80) == 0 ); n++ ) {
+				}
+				_PutSystemExclusiveData(phMIDI, &midi_msg[i], n);
+				i += n - 1;
+				continue;
+			}
+			else if ( ( midi_msg[i] < 0xF8 ) && ( midi_msg[i] != 0xF7 ) ) {
+				// a system exclusive message interrupted by a status byte is discarded,
+				// and the status byte starts a new message.
+				_AbortSystemExclusiveMessage(phMIDI);
+				phMIDI->state = PARSE_MIDI_IDLE;
+			}
+			else {
+				// F7, or a real time message which may appear in the middle of the data.
+			}
+		}
+
 		event = _GetParseMIDIMessageEvent(midi_msg[i]);
 
 		pfsm = &_midi_trans_state_tbl[phMIDI->state][event];
@@ -208,6 +354,41 @@ int32_t MIDI_Play(MIDI_Handle_t *phMIDI, const uint8_t *midi_msg, size_t len) {
 	return 0;
 }
 
+int32_t MIDI_PlayUsbPacket(MIDI_Handle_t *phMIDI, const uint8_t *packet) {
+
+	uint8_t cin = packet[0] & 0x0F;
+	uint8_t status = packet[1];
+
+	// channel voice messages (CIN 0x8-0xE) are complete in one packet,
+	// so they are dispatched directly without walking the parser FSM.
+	if ( ( cin >= 0x8 ) && ( cin <= 0xE ) && ( (status >> 4) == cin )
+	  && ( ( (packet[2] | packet[3]) & 0x80 ) == 0 ) ) {
+
+		if ( phMIDI->state == PARSE_MIDI_SYS_EX ) {
+			// a system exclusive message interrupted by a channel message is discarded.
+			_AbortSystemExclusiveMessage(phMIDI);
+		}
+
+		phMIDI->chmsg_buf.msg0 = status;
+
+		if ( _usb_midi_cin_size_tbl[cin] == 2 ) {
+			_ExecChannelMessage1(phMIDI, packet[2]);
+			phMIDI->state = PARSE_MIDI_CH_MSG_RUNNING_1;
+		}
+		else {
+			phMIDI->chmsg_buf.msg1 = packet[2];
+			_ExecChannelMessage2(phMIDI, packet[3]);
+			phMIDI->state = PARSE_MIDI_CH_MSG_RUNNING_2;
+		}
+
+		return 0;
+	}
+
+	// system exclusive, system common and real time messages,
+	// and malformed packets go through the byte parser.
+	return MIDI_Play(phMIDI, &packet[1], _usb_midi_cin_size_tbl[cin]);
+}
+
 __WEAK__ MIDI_Handle_t *MIDI_Alloc(void)
 {
 	static MIDI_Handle_t hMIDI;
@@ -227,90 +408,204 @@ static void _StoreChannelMessageData(MIDI_Handle_t *phMIDI, uint8_t msg) {
 	phMIDI->chmsg_buf.msg1 = msg;
 }
 
+static void _StartSystemExclusiveMessage(MIDI_Handle_t *phMIDI, uint8_t msg) {
+
+	const MIDI_Sink_t *psink = phMIDI->sink;
+	const MIDI_Sink_t *psink_end = &phMIDI->sink[phMIDI->n_sink];
+
+#if MAX_SYS_EX_BUF_SIZE > 0
+	phMIDI->sysex_buf.len = 0;
+	phMIDI->sysex_buf.msg[(phMIDI->sysex_buf.len)++] = msg;
+#else
+	(void)msg;
+#endif
+
+	if ( ( phMIDI->msg_mask & MIDI_MSG_MASK_SYSTEM_EXCLUSIVE ) == 0 ) {
+		// filtered out.
+		return;
+	}
+
+	for ( ; psink < psink_end; psink++ ) {
+		if ( ( psink->msg_mask & MIDI_MSG_MASK_SYSTEM_EXCLUSIVE )
+		  && ( psink->pcallback->system.exclusive_msg.pSysExStart != NULL ) ) {
+			psink->pcallback->system.exclusive_msg.pSysExStart();
+		}
+	}
+}
+
 static void _StoreSystemExclusiveMessage(MIDI_Handle_t *phMIDI, uint8_t msg) {
-	MIDI_System_Exclusive_Buffer_t *psys_ex_buf = &phMIDI->sysex_buf;
-	if (  psys_ex_buf->len < MAX_SYS_EX_BUF_SIZE ) {
-		psys_ex_buf->msg[(psys_ex_buf->len)++] = msg;
+	_PutSystemExclusiveData(phMIDI, &msg, 1);
+}
+
+static void _PutSystemExclusiveData(MIDI_Handle_t *phMIDI, const uint8_t *dat, size_t len) {
+
+	const MIDI_Sink_t *psink = phMIDI->sink;
+	const MIDI_Sink_t *psink_end = &phMIDI->sink[phMIDI->n_sink];
+
+#if MAX_SYS_EX_BUF_SIZE > 0
+	{
+		MIDI_System_Exclusive_Buffer_t *psys_ex_buf = &phMIDI->sysex_buf;
+		size_t i = 0;
+		// the bytes which do not fit in the buffer are truncated.
+		for ( i = 0; ( i < len ) && ( psys_ex_buf->len < MAX_SYS_EX_BUF_SIZE ); i++ ) {
+			psys_ex_buf->msg[(psys_ex_buf->len)++] = dat[i];
+		}
+	}
+#endif
+
+	if ( ( phMIDI->msg_mask & MIDI_MSG_MASK_SYSTEM_EXCLUSIVE ) == 0 ) {
+		// filtered out.
+		return;
+	}
+
+	for ( ; psink < psink_end; psink++ ) {
+		if ( ( psink->msg_mask & MIDI_MSG_MASK_SYSTEM_EXCLUSIVE )
+		  && ( psink->pcallback->system.exclusive_msg.pSysExData != NULL ) ) {
+			psink->pcallback->system.exclusive_msg.pSysExData(dat, len);
+		}
+	}
+}
+
+static void _AbortSystemExclusiveMessage(MIDI_Handle_t *phMIDI) {
+
+	const MIDI_Sink_t *psink = phMIDI->sink;
+	const MIDI_Sink_t *psink_end = &phMIDI->sink[phMIDI->n_sink];
+
+#if MAX_SYS_EX_BUF_SIZE > 0
+	phMIDI->sysex_buf.len = 0;
+#endif
+
+	if ( ( phMIDI->msg_mask & MIDI_MSG_MASK_SYSTEM_EXCLUSIVE ) == 0 ) {
+		// filtered out.
+		return;
+	}
+
+	for ( ; psink < psink_end; psink++ ) {
+		if ( ( psink->msg_mask & MIDI_MSG_MASK_SYSTEM_EXCLUSIVE )
+		  && ( psink->pcallback->system.exclusive_msg.pSysExEnd != NULL ) ) {
+			psink->pcallback->system.exclusive_msg.pSysExEnd(0);
+		}
 	}
 }
 
 static void _ExecChannelMessage1(MIDI_Handle_t *phMIDI, uint8_t msg) {
 
-	const MIDI_ChannelVoiceMessage_t *pchvmsg = &phMIDI->pcallback->channel.voice_msg;
+	const MIDI_ChannelVoiceMessage_t *pchvmsg = NULL;
+	const MIDI_Sink_t *psink = phMIDI->sink;
+	const MIDI_Sink_t *psink_end = &phMIDI->sink[phMIDI->n_sink];
+	uint8_t ch = phMIDI->chmsg_buf.msg0 & 0x0F;
+	uint16_t ch_bit = 1U << ch;
+	uint8_t msg_bit = MIDI_MSG_MASK_OF_STATUS(phMIDI->chmsg_buf.msg0);
 
 	phMIDI->chmsg_buf.msg1 = msg;
 
-	switch (phMIDI->chmsg_buf.msg0 & 0xF0) {
-		case 0xC0:
-		if ( pchvmsg->pProgramChange != NULL ) {
-			pchvmsg->pProgramChange(phMIDI->chmsg_buf.msg0 & 0x0F, phMIDI->chmsg_buf.msg1);
-		}
-		break;
+	if ( ( ( phMIDI->ch_mask & ch_bit ) == 0 ) || ( ( phMIDI->msg_mask & msg_bit ) == 0 ) ) {
+		// filtered out.
+		return;
+	}
 
-		case 0xD0:
-		if ( pchvmsg->pChannelPressure != NULL ) {
-			pchvmsg->pChannelPressure(phMIDI->chmsg_buf.msg0 & 0x0F, phMIDI->chmsg_buf.msg1);
+	for ( ; psink < psink_end; psink++ ) {
+
+		if ( ( ( psink->ch_mask & ch_bit ) == 0 ) || ( ( psink->msg_mask & msg_bit ) == 0 ) ) {
+			continue;
 		}
-		break;
+		pchvmsg = &psink->pcallback->channel.voice_msg;
+
+		switch (phMIDI->chmsg_buf.msg0 & 0xF0) {
+			case 0xC0:
+			pchvmsg->pProgramChange(ch, phMIDI->chmsg_buf.msg1);
+			break;
+
+			case 0xD0:
+			pchvmsg->pChannelPressure(ch, phMIDI->chmsg_buf.msg1);
+			break;
 
-		default:
-		break; 
+			default:
+			break; 
+		}
 	}
 }
 
 static void _ExecChannelMessage2(MIDI_Handle_t *phMIDI, uint8_t msg) {
 
-	const MIDI_ChannelVoiceMessage_t *pchvmsg = &phMIDI->pcallback->channel.voice_msg;
+	const MIDI_ChannelVoiceMessage_t *pchvmsg = NULL;
+	const MIDI_Sink_t *psink = phMIDI->sink;
+	const MIDI_Sink_t *psink_end = &phMIDI->sink[phMIDI->n_sink];
+	uint8_t ch = phMIDI->chmsg_buf.msg0 & 0x0F;
+	uint16_t ch_bit = 1U << ch;
+	uint8_t msg_bit = MIDI_MSG_MASK_OF_STATUS(phMIDI->chmsg_buf.msg0);
+
 	phMIDI->chmsg_buf.msg2 = msg;
 
-	switch (phMIDI->chmsg_buf.msg0 & 0xF0) {
-		case 0x80:
-		if ( pchvmsg->pNoteOff != NULL ) {
-			pchvmsg->pNoteOff(phMIDI->chmsg_buf.msg0 & 0x0F, phMIDI->chmsg_buf.msg1, phMIDI->chmsg_buf.msg2);
-		}
-		break;
+	if ( ( ( phMIDI->ch_mask & ch_bit ) == 0 ) || ( ( phMIDI->msg_mask & msg_bit ) == 0 ) ) {
+		// filtered out.
+		return;
+	}
 
-		case 0x90:
-		if ( pchvmsg->pNoteOn != NULL ) {
-			pchvmsg->pNoteOn(phMIDI->chmsg_buf.msg0 & 0x0F, phMIDI->chmsg_buf.msg1, phMIDI->chmsg_buf.msg2);
-		}
-		break;
+	for ( ; psink < psink_end; psink++ ) {
 
-		case 0xA0:
-		if ( pchvmsg->pPolyphonicKeyPressure != NULL ) {
-			pchvmsg->pPolyphonicKeyPressure(phMIDI->chmsg_buf.msg0 & 0x0F, phMIDI->chmsg_buf.msg1, phMIDI->chmsg_buf.msg2);
+		if ( ( ( psink->ch_mask & ch_bit ) == 0 ) || ( ( psink->msg_mask & msg_bit ) == 0 ) ) {
+			continue;
 		}
-		break;
+		pchvmsg = &psink->pcallback->channel.voice_msg;
 
-		case 0xB0:
-		if ( pchvmsg->pControlChange != NULL ) {
-			pchvmsg->pControlChange(phMIDI->chmsg_buf.msg0 & 0x0F, phMIDI->chmsg_buf.msg1, phMIDI->chmsg_buf.msg2);
-		}
-		break;
+		switch (phMIDI->chmsg_buf.msg0 & 0xF0) {
+			case 0x80:
+			pchvmsg->pNoteOff(ch, phMIDI->chmsg_buf.msg1, phMIDI->chmsg_buf.msg2);
+			break;
 
-		case 0xE0:
-		if ( pchvmsg->pPitchBendChange != NULL ) {
-			pchvmsg->pPitchBendChange(phMIDI->chmsg_buf.msg0 & 0x0F, phMIDI->chmsg_buf.msg1, phMIDI->chmsg_buf.msg2);
-		}
-		break;
+			case 0x90:
+			pchvmsg->pNoteOn(ch, phMIDI->chmsg_buf.msg1, phMIDI->chmsg_buf.msg2);
+			break;
+
+			case 0xA0:
+			pchvmsg->pPolyphonicKeyPressure(ch, phMIDI->chmsg_buf.msg1, phMIDI->chmsg_buf.msg2);
+			break;
+
+			case 0xB0:
+			pchvmsg->pControlChange(ch, phMIDI->chmsg_buf.msg1, phMIDI->chmsg_buf.msg2);
+			break;
+
+			case 0xE0:
+			pchvmsg->pPitchBendChange(ch, phMIDI->chmsg_buf.msg1, phMIDI->chmsg_buf.msg2);
+			break;
 
-		default:
-		break; 
+			default:
+			break; 
+		}
 	}
 }
 
 
 static void _ExecSystemExclusiveMessage(MIDI_Handle_t *phMIDI, uint8_t msg) {
 
-	const MIDI_SystemExclusiveMessage_t *psys_ex = &phMIDI->pcallback->system.exclusive_msg;
-	MIDI_System_Exclusive_Buffer_t *psys_ex_buf = &phMIDI->sysex_buf;
+	const MIDI_Sink_t *psink = phMIDI->sink;
+	const MIDI_Sink_t *psink_end = &phMIDI->sink[phMIDI->n_sink];
+	const MIDI_SystemExclusiveMessage_t *psys_ex = NULL;
 
 	(void)msg;
 
-	if ( psys_ex->pSystemExclusive != NULL ) {
-		psys_ex->pSystemExclusive(psys_ex_buf->msg, psys_ex_buf->len);
+	if ( ( phMIDI->msg_mask & MIDI_MSG_MASK_SYSTEM_EXCLUSIVE ) == 0 ) {
+		// filtered out.
+		psink_end = psink;
 	}
 
+	for ( ; psink < psink_end; psink++ ) {
+		if ( psink->msg_mask & MIDI_MSG_MASK_SYSTEM_EXCLUSIVE ) {
+			psys_ex = &psink->pcallback->system.exclusive_msg;
+#if MAX_SYS_EX_BUF_SIZE > 0
+			if ( psys_ex->pSystemExclusive != NULL ) {
+				psys_ex->pSystemExclusive(phMIDI->sysex_buf.msg, phMIDI->sysex_buf.len);
+			}
+#endif
+			if ( psys_ex->pSysExEnd != NULL ) {
+				psys_ex->pSysExEnd(1);
+			}
+		}
+	}
+
+#if MAX_SYS_EX_BUF_SIZE > 0
 	// clear
-	psys_ex_buf->len = 0;
-}
\ No newline at end of file
+	phMIDI->sysex_buf.len = 0;
+#endif
+}
@@ -34,10 +34,12 @@ typedef struct _MIDI_Channel_Message_Buffer {
     uint8_t pad;  // padding
 }MIDI_Channel_Message_Buffer_t;
 
+#if MAX_SYS_EX_BUF_SIZE > 0
 typedef struct _MIDI_System_Exclusive_Buffer {
 	uint8_t msg[MAX_SYS_EX_BUF_SIZE];
 	size_t	len;
 }MIDI_System_Exclusive_Buffer_t;
+#endif
 
 
 typedef enum _Parse_MIDI_Message_State {
@@ -67,7 +69,14 @@ typedef struct _MIDI_ChannelMessage {
 }MIDI_ChannelMessage_t;
 
 typedef struct _MIDI_SystemExclusiveMessage {
+    // whole message accumulated in the handle (not called if MAX_SYS_EX_BUF_SIZE is 0).
     void (*pSystemExclusive)(uint8_t *dat, size_t len);
+    // streaming: F0 received.
+    void (*pSysExStart)(void);
+    // streaming: data bytes between F0 and F7. dat points into the caller's buffer.
+    void (*pSysExData)(const uint8_t *dat, size_t len);
+    // streaming: F7 received (complete = 1), or discarded by a status byte other than F7 and real time messages (complete = 0).
+    void (*pSysExEnd)(uint8_t complete);
 }MIDI_SystemExclusiveMessage_t;
 
 typedef struct _MIDI_SystemMessage {
@@ -79,15 +88,53 @@ typedef struct _MIDI_Message_Callbacks {
     MIDI_SystemMessage_t        system;
 }MIDI_Message_Callbacks_t;
 
+// channel mask of the sink (bit n: MIDI channel n)
+#define MIDI_CH_MASK_ALL			0xFFFF
+
+// message type mask of the sink
+#define MIDI_MSG_MASK_NOTE_OFF			(1U << 0)
+#define MIDI_MSG_MASK_NOTE_ON			(1U << 1)
+#define MIDI_MSG_MASK_POLY_KEY_PRESSURE		(1U << 2)
+#define MIDI_MSG_MASK_CONTROL_CHANGE		(1U << 3)
+#define MIDI_MSG_MASK_PROGRAM_CHANGE		(1U << 4)
+#define MIDI_MSG_MASK_CHANNEL_PRESSURE		(1U << 5)
+#define MIDI_MSG_MASK_PITCH_BEND_CHANGE		(1U << 6)
+#define MIDI_MSG_MASK_SYSTEM_EXCLUSIVE		(1U << 7)
+#define MIDI_MSG_MASK_ALL			0xFF
+
+// message type mask bit of a channel message status byte (0x80-0xEF)
+#define MIDI_MSG_MASK_OF_STATUS(st)		(1U << ( ( (st) >> 4 ) - 8 ))
+
+// a receiver of the parsed messages
+typedef struct _MIDI_Sink {
+	const MIDI_Message_Callbacks_t	*pcallback;
+	uint16_t			ch_mask;
+	uint8_t				msg_mask; // masked with the registered callbacks
+	uint8_t				pad;
+}MIDI_Sink_t;
+
 typedef struct _MIDI_Handle {
 	MIDI_Channel_Message_Buffer_t	chmsg_buf;
+#if MAX_SYS_EX_BUF_SIZE > 0
 	MIDI_System_Exclusive_Buffer_t	sysex_buf;
-	const MIDI_Message_Callbacks_t	*pcallback;
+#endif
+	MIDI_Sink_t			sink[MAX_MIDI_SINK_NUM];
+	uint8_t				n_sink;
+	uint8_t				msg_filter; // message types enabled by the user
+	uint16_t			ch_filter;  // channels enabled by the user
+	uint16_t			ch_mask;    // ch_filter & channels of all sinks
+	uint8_t				msg_mask;   // msg_filter & message types of all sinks
 	Parse_MIDI_Message_State_t	state;
 }MIDI_Handle_t;
 
 extern MIDI_Handle_t *MIDI_Init(const MIDI_Message_Callbacks_t *pcallbacks );
 extern void MIDI_DeInit( MIDI_Handle_t *phMIDI );
+extern int32_t MIDI_AddSink(MIDI_Handle_t *phMIDI, const MIDI_Message_Callbacks_t *pcallbacks, uint16_t ch_mask, uint8_t msg_mask);
+extern int32_t MIDI_RemoveSink(MIDI_Handle_t *phMIDI, const MIDI_Message_Callbacks_t *pcallbacks);
+extern int32_t MIDI_SetSinkMask(MIDI_Handle_t *phMIDI, const MIDI_Message_Callbacks_t *pcallbacks, uint16_t ch_mask, uint8_t msg_mask);
+extern void MIDI_SetFilter(MIDI_Handle_t *phMIDI, uint16_t ch_mask, uint8_t msg_mask);
+extern void MIDI_GetFilter(const MIDI_Handle_t *phMIDI, uint16_t *ch_mask, uint8_t *msg_mask);
 extern int32_t MIDI_Play(MIDI_Handle_t *phMIDI, const uint8_t *midi_msg, size_t len);
+extern int32_t MIDI_PlayUsbPacket(MIDI_Handle_t *phMIDI, const uint8_t *packet);
 
 #endif // __MIDI_H__
@@ -34,4 +34,8 @@
 #define MAX_SYS_EX_BUF_SIZE 256
 #endif
 
+#ifndef MAX_MIDI_SINK_NUM
+#define MAX_MIDI_SINK_NUM 4
+#endif
+
 #endif /* __MIDICONF_H__ */
\ No newline at end of file
@@ -31,6 +31,13 @@
 #include "usb_midi_app.h"
 #include "single_ymz294.h"
 #include "music_box_ymf825.h"
+#include "poly_ymf825.h"
+#include "ymf825_tone_bank.h"
+#include "ymf825.h"
+#include "ymz294.h"
+#ifdef USE_LATENCY_STAT
+#include "latency_stat.h"
+#endif
 
 
 typedef struct
@@ -56,6 +63,7 @@ typedef enum
 	YMZ294_CMD_OPT_ID_ES,
 	YMZ294_CMD_OPT_ID_EP,
 	YMZ294_CMD_OPT_ID_NP,
+	YMZ294_CMD_OPT_ID_VM,
 }ymz294_cmd_opt_id_t;
 
 static int32_t try_parse_ymz294_setting(ymz294_cmd_opt_id_t opt_id, const char *str, ymz294_setting_t *out);
@@ -71,6 +79,12 @@ static int cmd_ymz294(int argc, char *argv[]);
 static int cmd_switch(int argc, char *argv[]);
 static int cmd_usage(int argc, char *argv[]);
 static int cmd_ymf825(int argc, char *argv[]);
+static uint8_t parse_voice_steal(const char *name);
+static int cmd_stat(int argc, char *argv[]);
+static int cmd_midi(int argc, char *argv[]);
+#ifdef USE_LATENCY_STAT
+static int cmd_latency(int argc, char *argv[]);
+#endif
 
 static const command_table_t command_table[] =
 {
@@ -110,7 +124,24 @@ static const command_table_t command_table[] =
 		 .label = "ymf825",
 		 .command = cmd_ymf825,
 		 .brief = "Set/Get the playing parameters of YMF825."
+	},
+	{
+		 .label = "stat",
+		 .command = cmd_stat,
+		 .brief = "Show statistics of the usb receive buffers, queues and the YMF825 register writes."
+	},
+	{
+		 .label = "midi",
+		 .command = cmd_midi,
+		 .brief = "Set/Get the channel and message type filter of the MIDI parser."
+	},
+#ifdef USE_LATENCY_STAT
+	{
+		 .label = "latency",
+		 .command = cmd_latency,
+		 .brief = "Show the latency of the note on messages from the usb reception to the SPI, and reset it."
 	}
+#endif
 };
 
 static const size_t n_command_table = sizeof(command_table) / sizeof(command_table[0]);
@@ -235,7 +266,8 @@ static const struct ymz294_cmd_opts
 	{"-em",  "Envelope mode [ off | on(use envelop)]"},
 	{"-es",  "Envelope shape [0x0-0xF]"},
 	{"-ep",  "Envelope frequency (EP) [0x0000-0xFFFF]"},
-	{"-np",  "Noise frequency (NP) [0x00-0x1F]"}
+	{"-np",  "Noise frequency (NP) [0x00-0x1F]"},
+	{"-vm",  "Voices to use [0x0-0x7] (bit0: A, bit1: B, bit2: C)"}
 };
 static const uint8_t n_ymz294_cmd_opt = sizeof(ymz294_cmd_opt)/sizeof(ymz294_cmd_opt[0]);
 
@@ -254,18 +286,19 @@ static int cmd_ymz294(int argc, char *argv[])
 	else if ( !strcmp(argv[1], "-ls" ) )
 	{// show current setting
 		uint8_t ch = 0;
-		usb_cdc_printf("ch\ten\tmx\tem\tes\tep\tnp\r\n");
+		usb_cdc_printf("ch\ten\tmx\tem\tes\tep\tnp\tvm\r\n");
 		for ( ch = 0; ch < MAX_MIDI_CH_NUMBER; ch++ )
 		{
 			get_ymz294_setting(ch, &setting);
-			usb_cdc_printf("%02u\t%s\t%s\t%s\t0x%02X\t0x%04X\t0x%02X\r\n", 
+			usb_cdc_printf("%02u\t%s\t%s\t%s\t0x%02X\t0x%04X\t0x%02X\t0x%X\r\n", 
 				ch,
 				setting.ch_enabled == YMZ294_CH_ENABLED_FALSE ? "false" : "true",
 				setting.sel_mixer == YMZ294_MIXER_TONE ? "tone" : "noise",
 				setting.env_mode == YMZ294_ENVELOPE_ENABLE ? "on" : "off",
 				setting.env_shape,
 				setting.env_freq,
-				setting.noise_freq
+				setting.noise_freq,
+				setting.voice_mask
 			);
 		}
 	}
@@ -361,15 +394,17 @@ static int cmd_ymz294(int argc, char *argv[])
 				if ( process_result == 0 )
 				{
 					set_ymz294_setting(setting_ch, &setting);
-					usb_cdc_printf("ch\ten\tmx\tem\tes\tep\tnp\r\n");
-					usb_cdc_printf("%02u\t%s\t%s\t%s\t0x%02X\t0x%04X\t0x%02X\r\n", 
+					update_usb_midi_sink_mask();
+					usb_cdc_printf("ch\ten\tmx\tem\tes\tep\tnp\tvm\r\n");
+					usb_cdc_printf("%02u\t%s\t%s\t%s\t0x%02X\t0x%04X\t0x%02X\t0x%X\r\n", 
 						setting_ch,
 						setting.ch_enabled == YMZ294_CH_ENABLED_FALSE ? "false" : "true",
 						setting.sel_mixer == YMZ294_MIXER_TONE ? "tone" : "noise",
 						setting.env_mode == YMZ294_ENVELOPE_ENABLE ? "on" : "off",
 						setting.env_shape,
 						setting.env_freq,
-						setting.noise_freq
+						setting.noise_freq,
+						setting.voice_mask
 					);
 				}
 			}
@@ -497,6 +532,16 @@ static int32_t try_parse_ymz294_setting(ymz294_cmd_opt_id_t opt_id, const char *
 		}
 		break;
 
+		case YMZ294_CMD_OPT_ID_VM:
+		{// -vm
+			result = try_parse_uint32(str, &value, 0x0, YMZ294_VOICE_MASK_ALL);
+			if ( result == 0 )
+			{
+				out->voice_mask = value;
+			}
+		}
+		break;
+
 		default:
 		{
 			result = PARSE_ERROR_UNEXPECTED;
@@ -528,6 +573,10 @@ static int cmd_switch(int argc, char *argv[])
 				{
 					switch_ymf825_sound_driver(YMF825_SOUND_DRIVER_MUSIC_BOX);
 				}
+				else if ( !strcmp(argv[2], "poly") )
+				{
+					switch_ymf825_sound_driver(YMF825_SOUND_DRIVER_POLY);
+				}
 				else
 				{
 				}
@@ -541,6 +590,10 @@ static int cmd_switch(int argc, char *argv[])
 			{
 				selected_driver_name = "mbox";
 			}
+			else if ( sound_driver == YMF825_SOUND_DRIVER_POLY )
+			{
+				selected_driver_name = "poly";
+			}
 			else
 			{
 			}
@@ -589,6 +642,26 @@ static int cmd_usage(int argc, char *argv[])
 	return 0;
 }
 
+static const char * const _voice_steal_name[NUM_OF_VOICE_ALLOC_STEAL] = {
+	"oldest",
+	"quietest",
+	"retrig"
+};
+
+// returns NUM_OF_VOICE_ALLOC_STEAL if the name is unknown.
+static uint8_t parse_voice_steal(const char *name)
+{
+	uint8_t i;
+	for ( i = 0; i < NUM_OF_VOICE_ALLOC_STEAL; i++ )
+	{
+		if ( !strcmp(name, _voice_steal_name[i]) )
+		{
+			break;
+		}
+	}
+	return i;
+}
+
 static int cmd_ymf825(int argc, char *argv[])
 {
 	ymf825_sound_driver_t sound_driver = NUM_OF_YMF825_SOUND_DRIVER;
@@ -610,11 +683,13 @@ static int cmd_ymf825(int argc, char *argv[])
 				{
 					config.percussion_msg = MUSIC_BOX_YMF825_ACCEPT_PERCUSSION_MESSAGE;
 					SetConfig_MUSIC_BOX_YMF825(&config);
+					update_usb_midi_sink_mask();
 				}
 				else if ( !strcmp(argv[2], "off") )
 				{
 					config.percussion_msg = MUSIC_BOX_YMF825_IGNORE_PERCUSSION_MESSAGE;
 					SetConfig_MUSIC_BOX_YMF825(&config);
+					update_usb_midi_sink_mask();
 				}
 				else
 				{
@@ -636,6 +711,34 @@ static int cmd_ymf825(int argc, char *argv[])
 			}
 			usb_cdc_printf("Program No: %u\r\n", config.program_no);
 		}
+		else if ( !strcmp(argv[1], "steal") )
+		{
+			if ( argv[2] )
+			{
+				config.voice_steal = parse_voice_steal(argv[2]);
+				SetConfig_MUSIC_BOX_YMF825(&config);
+				GetConfig_MUSIC_BOX_YMF825(&config);
+			}
+			usb_cdc_printf("Voice steal: %s\r\n", _voice_steal_name[config.voice_steal]);
+		}
+		else
+		{
+		}
+	}
+	else if ( sound_driver == YMF825_SOUND_DRIVER_POLY )
+	{
+		poly_ymf825_config_t config;
+		GetConfig_Poly_YMF825(&config);
+		if ( !strcmp(argv[1], "steal") )
+		{
+			if ( argv[2] )
+			{
+				config.voice_steal = parse_voice_steal(argv[2]);
+				SetConfig_Poly_YMF825(&config);
+				GetConfig_Poly_YMF825(&config);
+			}
+			usb_cdc_printf("Voice steal: %s\r\n", _voice_steal_name[config.voice_steal]);
+		}
 		else
 		{
 		}
@@ -645,4 +748,154 @@ static int cmd_ymf825(int argc, char *argv[])
 	}
 
 	return 0;
-}
\ No newline at end of file
+}
+
+static int cmd_stat(int argc, char *argv[])
+{
+	usb_rx_stat_t rx_stat;
+	usb_midi_coalesce_stat_t coalesce_stat;
+	ymf825_tone_bank_stat_t tone_bank_stat;
+	YMF825_ShadowStat_t shadow_stat;
+	YMF825_ToneUploadStat_t tone_upload_stat;
+#ifdef USE_YMF825_SPI_DMA
+	YMF825_SpiDmaStat_t spi_dma_stat;
+#endif
+	ymz294_shadow_stat_t ymz294_shadow_stat;
+#ifdef USE_YMZ294_BUS_QUEUE
+	ymz294_bus_stat_t ymz294_bus_stat;
+#endif
+
+	get_usb_rx_stat(&rx_stat);
+	usb_cdc_printf("usb midi rx busy\t: %lu\r\n", rx_stat.midi_busy_count);
+	usb_cdc_printf("usb cdc rx busy\t: %lu\r\n", rx_stat.cdc_busy_count);
+	usb_cdc_printf("midi queue full\t: %lu\r\n", get_usb_midi_event_queue_overflow_count());
+	usb_cdc_printf("cdc queue full\t: %lu\r\n", get_usb_cdc_receive_queue_overflow_count());
+
+	get_usb_midi_coalesce_stat(&coalesce_stat);
+	usb_cdc_printf("midi coalesced\t: cc %lu, bend %lu, pressure %lu\r\n",
+		coalesce_stat.cc_count,
+		coalesce_stat.pitch_bend_count,
+		coalesce_stat.pressure_count
+	);
+	usb_cdc_printf("midi notes ahead\t: %lu\r\n", get_usb_midi_note_lane_count());
+
+	GetStat_ToneBank_YMF825(&tone_bank_stat);
+	usb_cdc_printf("tone bank\t: write %lu, commit %lu, apply %lu, error %lu\r\n",
+		tone_bank_stat.write_count,
+		tone_bank_stat.commit_count,
+		tone_bank_stat.apply_count,
+		tone_bank_stat.error_count
+	);
+
+	YMF825_GetToneUploadStat(&tone_upload_stat);
+	usb_cdc_printf("ymf825 tone\t: upload %lu, merged %lu\r\n",
+		tone_upload_stat.upload_count,
+		tone_upload_stat.merge_count
+	);
+
+	YMF825_GetShadowStat(&shadow_stat);
+	usb_cdc_printf("ymf825 spi\t: write %lu, saved %lu bytes\r\n",
+		shadow_stat.written_bytes,
+		shadow_stat.saved_bytes
+	);
+#ifdef USE_YMF825_SPI_DMA
+	YMF825_GetSpiDmaStat(&spi_dma_stat);
+	usb_cdc_printf("ymf825 dma\t: complete %lu, underrun %lu, queue full %lu, timeout %lu\r\n",
+		spi_dma_stat.complete_count,
+		spi_dma_stat.underrun_count,
+		spi_dma_stat.queue_full_count,
+		spi_dma_stat.timeout_count
+	);
+#endif
+	ymz294_get_shadow_stat(&ymz294_shadow_stat);
+	usb_cdc_printf("ymz294 reg\t: write %lu, saved %lu\r\n",
+		ymz294_shadow_stat.write_count,
+		ymz294_shadow_stat.saved_count
+	);
+#ifdef USE_YMZ294_BUS_QUEUE
+	ymz294_get_bus_stat(&ymz294_bus_stat);
+	usb_cdc_printf("ymz294 bus\t: write %lu, coalesced %lu\r\n",
+		ymz294_bus_stat.write_count,
+		ymz294_bus_stat.coalesced_count
+	);
+#endif
+
+	return 0;
+}
+
+static int cmd_midi(int argc, char *argv[])
+{
+	uint16_t ch_mask = 0;
+	uint8_t msg_mask = 0;
+	unsigned long value = 0;
+	char *endptr = (char *)0;
+	int i = 0;
+
+	get_usb_midi_filter(&ch_mask, &msg_mask);
+
+	for ( i = 1; i + 1 < argc; i += 2 )
+	{
+		value = strtoul(argv[i+1], &endptr, 0);
+		if ( *endptr != '\0' )
+		{
+			usb_cdc_printf("Option '%s': Could not parse '%s'\r\n", argv[i], argv[i+1]);
+			return 0;
+		}
+
+		if ( !strcmp(argv[i], "-ch") && ( value <= 0xFFFF ) )
+		{
+			ch_mask = (uint16_t)value;
+		}
+		else if ( !strcmp(argv[i], "-msg") && ( value <= 0xFF ) )
+		{
+			msg_mask = (uint8_t)value;
+		}
+		else
+		{
+			usb_cdc_printf("Option '%s': '%s' is invalid\r\n", argv[i], argv[i+1]);
+			return 0;
+		}
+	}
+
+	if ( argc > 1 )
+	{
+		set_usb_midi_filter(ch_mask, msg_mask);
+	}
+
+	usb_cdc_printf("-ch\t0x%04X\t(bit n: channel n)\r\n", ch_mask);
+	usb_cdc_printf("-msg\t0x%02X\t(bit0: NoteOff, 1: NoteOn, 2: PolyKeyPress, 3: CC, 4: PC, 5: ChPress, 6: PitchBend, 7: SysEx)\r\n", msg_mask);
+
+	return 0;
+}
+
+#ifdef USE_LATENCY_STAT
+// cycles -> 0.1 usec
+static unsigned long cycle_to_100ns(uint32_t cycles)
+{
+	return (unsigned long)(((uint64_t)cycles * 10) / LATENCY_STAT_CYCLE_PER_US);
+}
+
+static int cmd_latency(int argc, char *argv[])
+{
+	latency_summary_t summary;
+	uint32_t i = 0;
+
+	usb_cdc_printf("stage\t\tcount\tmin\tavg\tmax\tp99 (usec)\r\n");
+	for ( i = 0; i < NUM_OF_LATENCY_STAGE; i++ )
+	{
+		latency_stat_get_summary((latency_stage_t)i, &summary);
+		usb_cdc_printf("%s\t\t%lu\t%lu.%lu\t%lu.%lu\t%lu.%lu\t%lu.%lu\r\n",
+			latency_stat_stage_name((latency_stage_t)i),
+			(unsigned long)summary.count,
+			cycle_to_100ns(summary.min) / 10, cycle_to_100ns(summary.min) % 10,
+			cycle_to_100ns(summary.avg) / 10, cycle_to_100ns(summary.avg) % 10,
+			cycle_to_100ns(summary.max) / 10, cycle_to_100ns(summary.max) % 10,
+			cycle_to_100ns(summary.p99) / 10, cycle_to_100ns(summary.p99) % 10
+		);
+	}
+	usb_cdc_printf("skipped (spi, total)\t: %lu\r\n", (unsigned long)latency_stat_get_skipped_count());
+	latency_stat_reset();
+
+	return 0;
+}
+#endif
@@ -29,6 +29,21 @@
 #include "ymz294.h"
 #endif
 
+// usb cdc receive queue size (unit: byte, must be a power of 2)
+#ifndef USB_CDC_RECEIVE_QUEUE_SIZE
+#define USB_CDC_RECEIVE_QUEUE_SIZE	512
+#endif
+
+// usb cdc receive queue
+// producer: usb interrupt (usb_cdc_receive_irq), consumer: main loop (usb_cdc_task).
+typedef struct
+{
+	volatile uint32_t head; // updated only by the producer.
+	volatile uint32_t tail; // updated only by the consumer.
+	uint32_t overflow_count;
+	uint8_t data[USB_CDC_RECEIVE_QUEUE_SIZE];
+} usb_cdc_receive_queue_t;
+
 static int32_t send_recv_ymf825(const uint8_t *bin_array, size_t bin_len);
 #ifdef USE_SINGLE_YMZ294
 static int32_t send_ymz294(const uint8_t *bin_array, size_t bin_len);
@@ -36,8 +51,14 @@ static int32_t send_ymz294(const uint8_t *bin_array, size_t bin_len);
 
 static sound_source_t registered_source = SOUND_SOURCE_YMF825;
 
+static usb_cdc_receive_queue_t cdc_receive_queue;
+
 void init_usb_cdc_app(void)
 {
+	cdc_receive_queue.head = 0;
+	cdc_receive_queue.tail = 0;
+	cdc_receive_queue.overflow_count = 0;
+
 	mshell_init();
 	mshell_register_hexmode_recv_callback(send_recv_ymf825);
 }
@@ -47,6 +68,56 @@ int32_t usb_cdc_proc(const uint8_t *data, size_t len)
 	return mshell_proc(data, len);
 }
 
+// called from the usb interrupt. only stores the received data in the receive queue.
+int32_t usb_cdc_receive_irq(const uint8_t *data, size_t len)
+{
+	uint32_t i = 0;
+	uint32_t head = cdc_receive_queue.head;
+
+	if ( USB_CDC_RECEIVE_QUEUE_SIZE - (head - cdc_receive_queue.tail) < len )
+	{// not enough space for the whole usb packet. the usb driver holds it and passes it again later.
+		cdc_receive_queue.overflow_count++;
+		return -1;
+	}
+
+	for ( i = 0; i < len; i++ )
+	{
+		cdc_receive_queue.data[head & (USB_CDC_RECEIVE_QUEUE_SIZE-1)] = data[i];
+		head++;
+	}
+
+	// publish the stored data to the consumer.
+	cdc_receive_queue.head = head;
+
+	return 0;
+}
+
+// called from the main loop. passes the received data to the shell.
+void usb_cdc_task(void)
+{
+	uint32_t tail = cdc_receive_queue.tail;
+	uint32_t head = cdc_receive_queue.head;
+	uint32_t pos = 0;
+	uint32_t len = 0;
+
+	while ( tail != head )
+	{
+		// pass the contiguous part of the queue at once.
+		pos = tail & (USB_CDC_RECEIVE_QUEUE_SIZE-1);
+		len = head - tail;
+		if ( len > USB_CDC_RECEIVE_QUEUE_SIZE - pos )
+		{
+			len = USB_CDC_RECEIVE_QUEUE_SIZE - pos;
+		}
+
+		usb_cdc_proc(&cdc_receive_queue.data[pos], len);
+
+		tail += len;
+		// release the area to the producer.
+		cdc_receive_queue.tail = tail;
+	}
+}
+
 
 int32_t set_hexmode_sound_source(sound_source_t source)
 {
@@ -86,6 +157,11 @@ sound_source_t get_hexmode_sound_source(void)
 	return registered_source;
 }
 
+uint32_t get_usb_cdc_receive_queue_overflow_count(void)
+{
+	return cdc_receive_queue.overflow_count;
+}
+
 
 static int32_t send_recv_ymf825(const uint8_t *bin_array, size_t bin_len)
 {
@@ -121,7 +197,7 @@ static int32_t send_ymz294(const uint8_t *bin_array, size_t bin_len)
 
 	for ( i = 0; i < bin_len; i+=2 )
 	{
-		ymz294_write(bin_array[i], bin_array[i+1]);
+		ymz294_write_force(bin_array[i], bin_array[i+1]);
 	}
 
 	return 0;
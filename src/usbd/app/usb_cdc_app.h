@@ -35,7 +35,10 @@ typedef enum
 
 extern void init_usb_cdc_app(void);
 extern int32_t usb_cdc_proc(const uint8_t *data, size_t len);
+extern int32_t usb_cdc_receive_irq(const uint8_t *data, size_t len);
+extern void usb_cdc_task(void);
 extern int32_t set_hexmode_sound_source(sound_source_t source);
 extern sound_source_t get_hexmode_sound_source(void);
+extern uint32_t get_usb_cdc_receive_queue_overflow_count(void);
 
 #endif//__USB_CDC_APP_H__
@@ -25,14 +25,56 @@
 #include "midi.h"
 #include "mode4_ymf825.h"
 #include "music_box_ymf825.h"
+#include "poly_ymf825.h"
+#include "ymf825_tone_bank.h"
+#include "ymf825.h"
 #include "single_ymz294.h"
+#ifdef USE_LATENCY_STAT
+#include "latency_stat.h"
+#include "ymz294.h"
+#endif
 
-#define MAX_MIDI_HANDLE_LIST_COUNT      2
+#define MAX_MIDI_HANDLE_LIST_COUNT      1
 #define MIDI_HANDLE_FREE                0 
 #define MIDI_HANDLE_OCCUPIED            1
 
 #define USB_MIDI_APP_ASSERT(cond)
 
+#define USB_MIDI_CIN_NOTE_OFF           0x08
+#define USB_MIDI_CIN_NOTE_ON            0x09
+#define USB_MIDI_CIN_POLY_KEY_PRESSURE  0x0A
+#define USB_MIDI_CIN_CONTROL_CHANGE     0x0B
+#define USB_MIDI_CIN_PROGRAM_CHANGE     0x0C
+#define USB_MIDI_CIN_CHANNEL_PRESSURE   0x0D
+#define USB_MIDI_CIN_PITCH_BEND         0x0E
+
+// usb midi event queue size (unit: usb midi event packet, must be a power of 2)
+#ifndef USB_MIDI_EVENT_QUEUE_SIZE
+#define USB_MIDI_EVENT_QUEUE_SIZE       256
+#endif
+
+// number of the queued packets searched for a later value of a controller, bend or pressure.
+#ifndef USB_MIDI_COALESCE_WINDOW
+#define USB_MIDI_COALESCE_WINDOW        32
+#endif
+
+// number of the queued packets searched for the notes to be played ahead.
+#ifndef USB_MIDI_NOTE_LANE_WINDOW
+#define USB_MIDI_NOTE_LANE_WINDOW       32
+#endif
+
+// left in the queue in place of a packet played ahead of the tail.
+#define USB_MIDI_EVENT_HOLE             0x00000000
+
+// the packets of the note lane are played ahead of the packets of the continuous lane
+// queued before them on the other channels. the others are played in the order they come.
+typedef enum
+{
+	USB_MIDI_LANE_NOTE = 0,		// note on/off, all sound off and all notes off
+	USB_MIDI_LANE_CONTINUOUS,	// controllers, pitch bend and pressure which may be coalesced
+	USB_MIDI_LANE_ORDERED		// the others
+} usb_midi_lane_t;
+
 typedef struct 
 {
 	uint32_t status;
@@ -45,90 +87,238 @@ typedef struct _usb_midi_event_packet
 	uint8_t midi[3];
 } usb_midi_event_packet_t;
 
-static const size_t _cin_midi_x_size_tbl[16] = 
+// usb midi event queue
+// producer: usb interrupt (usb_midi_receive_irq), consumer: main loop (usb_midi_task).
+typedef struct
 {
-	0, 0, 2, 3, 3, 1, 2, 3, 3, 3, 3, 3, 2, 2, 3, 1
-};
+	volatile uint32_t head; // updated only by the producer.
+	volatile uint32_t tail; // updated only by the consumer.
+	uint32_t overflow_count;
+	uint32_t event[USB_MIDI_EVENT_QUEUE_SIZE];
+#ifdef USE_LATENCY_STAT
+	uint32_t rx_stamp[USB_MIDI_EVENT_QUEUE_SIZE]; // mcycle at the usb reception
+#endif
+} usb_midi_event_queue_t;
 
 typedef struct
 {
-	MIDI_Handle_t* (*midi_init)(void);
-	void (*midi_deinit)(MIDI_Handle_t *phMIDI);
+	const MIDI_Message_Callbacks_t* (*midi_init)(void);
+	void (*midi_deinit)(void);
+	uint16_t (*get_ch_mask)(void); // channels to be received (NULL: all)
 } sound_driver_api_t;
 
 static sound_driver_api_t lst_ymf825_api[NUM_OF_YMF825_SOUND_DRIVER] = 
 {
 	{// MODE4
 		MIDI_Mode4_YMF825_Init,
-		MIDI_Mode4_YMF825_DeInit
+		MIDI_Mode4_YMF825_DeInit,
+		NULL
 	},
 	{// MUSIC_BOX
 		MIDI_MUSIC_BOX_YMF825_Init,
-		MIDI_MUSIC_BOX_YMF825_DeInit
+		MIDI_MUSIC_BOX_YMF825_DeInit,
+		GetChMask_MUSIC_BOX_YMF825
+	},
+	{// POLY
+		MIDI_Poly_YMF825_Init,
+		MIDI_Poly_YMF825_DeInit,
+		NULL
 	}
 };
 static ymf825_sound_driver_t ymf825_sound_driver = YMF825_SOUND_DRIVER_MUSIC_BOX;
 static ymf825_sound_driver_t bak_ymf825_sound_driver = YMF825_SOUND_DRIVER_MUSIC_BOX;
 
-static MIDI_Handle_t *ph_midi_ymf825;
+// one parser handle, the sound drivers are registered in it as sinks.
+static MIDI_Handle_t *ph_midi;
+static const MIDI_Message_Callbacks_t *p_ymf825_callbacks;
 #ifdef USE_SINGLE_YMZ294
-static MIDI_Handle_t *ph_midi_ymz294;
+static const MIDI_Message_Callbacks_t *p_ymz294_callbacks;
 #endif
 
 static  midi_handle_list_t hmidi_list[MAX_MIDI_HANDLE_LIST_COUNT];
 
+static usb_midi_event_queue_t midi_event_queue;
+static usb_midi_coalesce_stat_t midi_coalesce_stat;
+static uint32_t midi_note_lane_count;
+
 
 static void init_midi_handle_list(void);
+static void update_ymf825_sound_driver(void);
+static void all_notes_off(uint16_t ch_mask);
+static void play_usb_midi_event_packet(const usb_midi_event_packet_t *packet);
+static void play_usb_midi_event(uint32_t event);
+static void play_queued_event(uint32_t pos, uint32_t event);
+#ifdef USE_LATENCY_STAT
+static void check_spi_complete(void);
+#endif
+static usb_midi_lane_t get_event_lane(uint32_t event);
+static void play_note_lane(uint32_t tail, uint32_t head);
+static uint8_t is_superseded_event(uint32_t tail, uint32_t head, uint32_t event);
+static void count_coalesced_event(uint32_t event);
 
 void init_usb_midi_app(void)
 {
 	init_midi_handle_list();
 
+	midi_event_queue.head = 0;
+	midi_event_queue.tail = 0;
+	midi_event_queue.overflow_count = 0;
+	midi_coalesce_stat.cc_count = 0;
+	midi_coalesce_stat.pitch_bend_count = 0;
+	midi_coalesce_stat.pressure_count = 0;
+	midi_note_lane_count = 0;
+
+#ifdef USE_LATENCY_STAT
+	init_latency_stat();
+#ifdef USE_YMF825_SPI_DMA
+	YMF825_SetSpiTxCompleteCallback(check_spi_complete);
+#endif
+#if defined(USE_SINGLE_YMZ294) && defined(USE_YMZ294_BUS_QUEUE)
+	ymz294_set_bus_idle_callback(check_spi_complete);
+#endif
+#endif
+
+	ph_midi = MIDI_Init((const MIDI_Message_Callbacks_t *)0);
+	USB_MIDI_APP_ASSERT( ph_midi != (MIDI_Handle_t *)0 );
+
 	// Initialize sound driver of YMF825.
 	ymf825_sound_driver = YMF825_SOUND_DRIVER_MUSIC_BOX;
-	ph_midi_ymf825 = lst_ymf825_api[ymf825_sound_driver].midi_init();
-	USB_MIDI_APP_ASSERT( ph_midi_ymf825 != (MIDI_Handle_t *)0 );
+	p_ymf825_callbacks = lst_ymf825_api[ymf825_sound_driver].midi_init();
+	USB_MIDI_APP_ASSERT( p_ymf825_callbacks != (const MIDI_Message_Callbacks_t *)0 );
+	MIDI_AddSink(ph_midi, p_ymf825_callbacks, MIDI_CH_MASK_ALL, MIDI_MSG_MASK_ALL);
 
 #ifdef USE_SINGLE_YMZ294
 	// Initialize sound driver of YMZ294
-	ph_midi_ymz294 = midi_ymz294_init();
-	USB_MIDI_APP_ASSERT( ph_midi_ymz294 != (MIDI_Handle_t *)0 );
+	p_ymz294_callbacks = midi_ymz294_init();
+	USB_MIDI_APP_ASSERT( p_ymz294_callbacks != (const MIDI_Message_Callbacks_t *)0 );
+	MIDI_AddSink(ph_midi, p_ymz294_callbacks, MIDI_CH_MASK_ALL, MIDI_MSG_MASK_ALL);
 #endif
+
+	// SysEx tone bank upload of YMF825.
+	MIDI_AddSink(ph_midi, MIDI_ToneBank_YMF825_Init(), MIDI_CH_MASK_ALL, MIDI_MSG_MASK_SYSTEM_EXCLUSIVE);
+
+	update_usb_midi_sink_mask();
 }
 
 int32_t usb_midi_proc(const uint8_t *mid_msg,  size_t len)
 {
 	uint32_t i = 0;
-	size_t midi_x_size = 0;
-	usb_midi_event_packet_t *packet = (usb_midi_event_packet_t *)0;
-	uint8_t cin = 0;
 
-	if ( bak_ymf825_sound_driver != ymf825_sound_driver )
-	{// Switch sound driver of YMF825
-		lst_ymf825_api[ymf825_sound_driver].midi_deinit(ph_midi_ymf825);
-		ph_midi_ymf825 = lst_ymf825_api[ymf825_sound_driver].midi_init();
-		USB_MIDI_APP_ASSERT( ph_midi_ymf825 != (MIDI_Handle_t *)0 );
-		bak_ymf825_sound_driver = ymf825_sound_driver;
-	}
+	update_ymf825_sound_driver();
 
 	len &= ~0x3UL; // 4 bytes alignment.
 
 	for ( i = 0; i < len; i += 4 ) 
 	{
-		packet = (usb_midi_event_packet_t *)&mid_msg[i];
-		cin = packet->header & 0x0f;
-		midi_x_size = _cin_midi_x_size_tbl[cin];
-		if ( midi_x_size != 0 )
-		{
-			MIDI_Play(ph_midi_ymf825, &packet->midi[0], midi_x_size);
-#ifdef USE_SINGLE_YMZ294
-			MIDI_Play(ph_midi_ymz294, &packet->midi[0], midi_x_size);
+		play_usb_midi_event_packet((const usb_midi_event_packet_t *)&mid_msg[i]);
+	}
+	return 0;
+}
+
+// called from the usb interrupt. only stores the received packets in the event queue.
+int32_t usb_midi_receive_irq(const uint8_t *mid_msg,  size_t len)
+{
+	uint32_t i = 0;
+	uint32_t head = midi_event_queue.head;
+	uint32_t n_packet = 0;
+#ifdef USE_LATENCY_STAT
+	uint32_t rx_stamp = latency_stat_get_rx_stamp();
 #endif
-		}
+
+	len &= ~0x3UL; // 4 bytes alignment.
+	n_packet = len >> 2;
+
+	if ( USB_MIDI_EVENT_QUEUE_SIZE - (head - midi_event_queue.tail) < n_packet )
+	{// not enough space for the whole usb packet. the usb driver holds it and passes it again later.
+		midi_event_queue.overflow_count++;
+		return -1;
+	}
+
+	for ( i = 0; i < len; i += 4 )
+	{
+		midi_event_queue.event[head & (USB_MIDI_EVENT_QUEUE_SIZE-1)] = 
+			  ((uint32_t)mid_msg[i+0] <<  0)
+			| ((uint32_t)mid_msg[i+1] <<  8)
+			| ((uint32_t)mid_msg[i+2] << 16)
+			| ((uint32_t)mid_msg[i+3] << 24);
+#ifdef USE_LATENCY_STAT
+		midi_event_queue.rx_stamp[head & (USB_MIDI_EVENT_QUEUE_SIZE-1)] = rx_stamp;
+#endif
+		head++;
 	}
+
+	// publish the stored packets to the consumer.
+	midi_event_queue.head = head;
+
 	return 0;
 }
 
+// called from the main loop. plays all the packets stored in the event queue.
+void usb_midi_task(void)
+{
+	uint32_t tail = midi_event_queue.tail;
+	uint32_t head = midi_event_queue.head;
+	uint32_t event = 0;
+
+	update_ymf825_sound_driver();
+
+	while ( tail != head )
+	{
+		event = midi_event_queue.event[tail & (USB_MIDI_EVENT_QUEUE_SIZE-1)];
+
+		if ( event == USB_MIDI_EVENT_HOLE )
+		{// already played ahead.
+			tail++;
+			midi_event_queue.tail = tail;
+			continue;
+		}
+
+		// the messages wait while the tone parameters are uploaded, since the chip is muted meanwhile.
+		// only the program changes go on, to be merged into the upload.
+		if ( YMF825_IsToneUploadBusy() && ( ( event & 0x0F ) != USB_MIDI_CIN_PROGRAM_CHANGE ) )
+		{
+			break;
+		}
+		if ( is_superseded_event(tail, head, event) )
+		{// a later packet in the queue sets the same value. only the last one is played.
+			count_coalesced_event(event);
+		}
+		else
+		{
+			if ( get_event_lane(event) == USB_MIDI_LANE_CONTINUOUS )
+			{// the notes queued behind are not kept waiting for the controllers of the other channels.
+				play_note_lane(tail, head);
+			}
+			play_queued_event(tail & (USB_MIDI_EVENT_QUEUE_SIZE-1), event);
+		}
+
+		tail++;
+		// release the slot to the producer.
+		midi_event_queue.tail = tail;
+	}
+
+	// apply the committed tone bank between the messages.
+	Task_ToneBank_YMF825();
+
+	// upload the tone parameters requested by the messages above.
+	YMF825_Task();
+}
+
+uint32_t get_usb_midi_event_queue_overflow_count(void)
+{
+	return midi_event_queue.overflow_count;
+}
+
+void get_usb_midi_coalesce_stat(usb_midi_coalesce_stat_t *stat)
+{
+	*stat = midi_coalesce_stat;
+}
+
+uint32_t get_usb_midi_note_lane_count(void)
+{
+	return midi_note_lane_count;
+}
+
 int32_t switch_ymf825_sound_driver(ymf825_sound_driver_t driver)
 {
 	if ( NUM_OF_YMF825_SOUND_DRIVER <= driver )
@@ -144,6 +334,46 @@ ymf825_sound_driver_t get_selected_ymf825_sound_driver(void)
 	return ymf825_sound_driver;
 }
 
+// call after changing the settings of the sound drivers which select the channels to be played.
+void update_usb_midi_sink_mask(void)
+{
+	uint16_t ch_mask = MIDI_CH_MASK_ALL;
+
+	if ( lst_ymf825_api[ymf825_sound_driver].get_ch_mask )
+	{
+		ch_mask = lst_ymf825_api[ymf825_sound_driver].get_ch_mask();
+	}
+	MIDI_SetSinkMask(ph_midi, p_ymf825_callbacks, ch_mask, MIDI_MSG_MASK_ALL);
+
+#ifdef USE_SINGLE_YMZ294
+	MIDI_SetSinkMask(ph_midi, p_ymz294_callbacks, get_ymz294_ch_mask(), MIDI_MSG_MASK_ALL);
+#endif
+}
+
+void set_usb_midi_filter(uint16_t ch_mask, uint8_t msg_mask)
+{
+	uint16_t cur_ch_mask = 0;
+	uint8_t cur_msg_mask = 0;
+	uint16_t off_ch_mask = 0;
+
+	// the note off messages of the channels filtered out no longer reach the sound drivers,
+	// release their notes now.
+	MIDI_GetFilter(ph_midi, &cur_ch_mask, &cur_msg_mask);
+	off_ch_mask = cur_ch_mask & ~ch_mask;
+	if ( ( cur_msg_mask & ~msg_mask ) & ( MIDI_MSG_MASK_NOTE_OFF | MIDI_MSG_MASK_NOTE_ON ) )
+	{// note off, or note on with velocity 0.
+		off_ch_mask = cur_ch_mask;
+	}
+	all_notes_off(off_ch_mask);
+
+	MIDI_SetFilter(ph_midi, ch_mask, msg_mask);
+}
+
+void get_usb_midi_filter(uint16_t *ch_mask, uint8_t *msg_mask)
+{
+	MIDI_GetFilter(ph_midi, ch_mask, msg_mask);
+}
+
 MIDI_Handle_t *MIDI_Alloc(void)
 {
 	uint32_t i = 0;
@@ -171,6 +401,270 @@ void MIDI_Free(MIDI_Handle_t *phMIDI)
 	}
 }
 
+static void update_ymf825_sound_driver(void)
+{
+	if ( bak_ymf825_sound_driver != ymf825_sound_driver )
+	{// Switch sound driver of YMF825
+		MIDI_RemoveSink(ph_midi, p_ymf825_callbacks);
+		lst_ymf825_api[bak_ymf825_sound_driver].midi_deinit();
+		p_ymf825_callbacks = lst_ymf825_api[ymf825_sound_driver].midi_init();
+		USB_MIDI_APP_ASSERT( p_ymf825_callbacks != (const MIDI_Message_Callbacks_t *)0 );
+		MIDI_AddSink(ph_midi, p_ymf825_callbacks, MIDI_CH_MASK_ALL, MIDI_MSG_MASK_ALL);
+		update_usb_midi_sink_mask();
+		bak_ymf825_sound_driver = ymf825_sound_driver;
+	}
+}
+
+// sends All Note Off to the sound drivers on each channel of ch_mask.
+static void all_notes_off(uint16_t ch_mask)
+{
+	uint8_t ch = 0;
+
+	for ( ch = 0; ch < 16; ch++ )
+	{
+		if ( ( ch_mask & (1U << ch) ) == 0 )
+		{
+			continue;
+		}
+		if ( p_ymf825_callbacks->channel.voice_msg.pControlChange )
+		{
+			p_ymf825_callbacks->channel.voice_msg.pControlChange(ch, 123, 0);
+		}
+#ifdef USE_SINGLE_YMZ294
+		if ( p_ymz294_callbacks->channel.voice_msg.pControlChange )
+		{
+			p_ymz294_callbacks->channel.voice_msg.pControlChange(ch, 123, 0);
+		}
+#endif
+	}
+}
+
+static void play_usb_midi_event_packet(const usb_midi_event_packet_t *packet)
+{
+	MIDI_PlayUsbPacket(ph_midi, &packet->header);
+}
+
+static void play_usb_midi_event(uint32_t event)
+{
+	usb_midi_event_packet_t packet;
+
+	packet.header  = (uint8_t)(event >>  0);
+	packet.midi[0] = (uint8_t)(event >>  8);
+	packet.midi[1] = (uint8_t)(event >> 16);
+	packet.midi[2] = (uint8_t)(event >> 24);
+
+	play_usb_midi_event_packet(&packet);
+}
+
+// controllers whose values are used in the order they come (bank select, data entry,
+// switches, RPN/NRPN and channel mode messages) are never coalesced.
+static uint8_t is_continuous_cc(uint8_t cc)
+{
+	if (( cc == 0x00 ) || ( cc == 0x06 ) || ( cc == 0x20 ) || ( cc == 0x26 )
+	||  (( cc >= 0x40 ) && ( cc <= 0x45 ))
+	||  (( cc >= 0x60 ) && ( cc <= 0x65 ))
+	||  ( cc >= 0x78 ))
+	{
+		return 0;
+	}
+	return 1;
+}
+
+// the packets of the same key set the same value. the later one supersedes the earlier one.
+// 0: the packet is never superseded.
+static uint32_t get_coalesce_key(uint32_t event)
+{
+	switch ( event & 0x0F )
+	{
+	case USB_MIDI_CIN_CONTROL_CHANGE:
+		if ( !is_continuous_cc((uint8_t)(event >> 16) & 0x7F) )
+		{
+			return 0;
+		}
+		return event & 0x00FFFFFF; // cable, channel and controller number
+	case USB_MIDI_CIN_POLY_KEY_PRESSURE:
+		return event & 0x00FFFFFF; // cable, channel and key number
+	case USB_MIDI_CIN_CHANNEL_PRESSURE:
+	case USB_MIDI_CIN_PITCH_BEND:
+		return event & 0x0000FFFF; // cable and channel
+	default:
+		return 0;
+	}
+}
+
+// searches the queued packets after the tail for a later value of the same key.
+// the search stops at a packet which is not coalesced on the same channel (a note for example),
+// since it may use the earlier value, and at any system message.
+static uint8_t is_superseded_event(uint32_t tail, uint32_t head, uint32_t event)
+{
+	uint32_t key = get_coalesce_key(event);
+	uint32_t next = 0;
+	uint32_t next_key = 0;
+	uint32_t n = head - tail;
+	uint32_t i = 0;
+
+	if ( key == 0 )
+	{
+		return 0;
+	}
+
+	if ( n > USB_MIDI_COALESCE_WINDOW )
+	{
+		n = USB_MIDI_COALESCE_WINDOW;
+	}
+
+	for ( i = 1; i < n; i++ )
+	{
+		next = midi_event_queue.event[(tail + i) & (USB_MIDI_EVENT_QUEUE_SIZE-1)];
+		if ( next == USB_MIDI_EVENT_HOLE )
+		{
+			continue;
+		}
+		next_key = get_coalesce_key(next);
+		if ( next_key == key )
+		{
+			return 1;
+		}
+		if ( ( next & 0x0F ) < USB_MIDI_CIN_NOTE_OFF || ( next & 0x0F ) > USB_MIDI_CIN_PITCH_BEND )
+		{// system messages
+			return 0;
+		}
+		if (( next_key == 0 )
+		&&  ( ( next & 0x0FF0 ) == ( event & 0x0FF0 ) )) // cable and channel
+		{
+			return 0;
+		}
+	}
+	return 0;
+}
+
+static void count_coalesced_event(uint32_t event)
+{
+	switch ( event & 0x0F )
+	{
+	case USB_MIDI_CIN_CONTROL_CHANGE:
+		midi_coalesce_stat.cc_count++;
+		break;
+	case USB_MIDI_CIN_PITCH_BEND:
+		midi_coalesce_stat.pitch_bend_count++;
+		break;
+	default:
+		midi_coalesce_stat.pressure_count++;
+		break;
+	}
+}
+
+// pos: position of the packet in the event queue.
+static void play_queued_event(uint32_t pos, uint32_t event)
+{
+#ifdef USE_LATENCY_STAT
+	uint32_t dispatch_start = 0;
+	uint32_t dispatch_end = 0;
+
+	if ( ( ( event & 0x0F ) == USB_MIDI_CIN_NOTE_ON ) && ( ( event >> 24 ) & 0x7F ) )
+	{// note on (velocity > 0)
+		dispatch_start = LATENCY_STAT_NOW();
+		play_usb_midi_event(event);
+		dispatch_end = LATENCY_STAT_NOW();
+
+		latency_stat_add(LATENCY_STAGE_QUEUE, dispatch_start - midi_event_queue.rx_stamp[pos]);
+		latency_stat_add(LATENCY_STAGE_DISPATCH, dispatch_end - dispatch_start);
+		latency_stat_dispatched(midi_event_queue.rx_stamp[pos], dispatch_end);
+		check_spi_complete();
+		return;
+	}
+#else
+	(void)pos;
+#endif
+	play_usb_midi_event(event);
+}
+
+#ifdef USE_LATENCY_STAT
+// ends the pending latency measurements when neither SPI has a queued transfer left.
+// also called from the interrupts which send the queued transfers.
+static void check_spi_complete(void)
+{
+#ifdef USE_YMF825_SPI_DMA
+	if ( YMF825_IsSpiTxBusy() )
+	{
+		return;
+	}
+#endif
+#if defined(USE_SINGLE_YMZ294) && defined(USE_YMZ294_BUS_QUEUE)
+	if ( ymz294_is_bus_busy() )
+	{
+		return;
+	}
+#endif
+	latency_stat_spi_complete();
+}
+#endif
+
+static usb_midi_lane_t get_event_lane(uint32_t event)
+{
+	uint8_t cc = 0;
+
+	switch ( event & 0x0F )
+	{
+	case USB_MIDI_CIN_NOTE_OFF:
+	case USB_MIDI_CIN_NOTE_ON:
+		return USB_MIDI_LANE_NOTE;
+	case USB_MIDI_CIN_CONTROL_CHANGE:
+		cc = (uint8_t)(event >> 16) & 0x7F;
+		if ( ( cc == 0x78 ) || ( cc == 0x7B ) ) // all sound off, all notes off
+		{
+			return USB_MIDI_LANE_NOTE;
+		}
+		break;
+	default:
+		break;
+	}
+	return ( get_coalesce_key(event) != 0 ) ? USB_MIDI_LANE_CONTINUOUS : USB_MIDI_LANE_ORDERED;
+}
+
+// plays the packets of the note lane queued after the tail, and leaves holes in their place.
+// a packet is played ahead only if no earlier packet of its channel is left in the queue,
+// so the order within a channel is kept. system messages are never overtaken.
+static void play_note_lane(uint32_t tail, uint32_t head)
+{
+	uint32_t n = head - tail;
+	uint32_t idx = 0;
+	uint32_t event = 0;
+	uint16_t ch_bit = 0;
+	uint16_t blocked_ch = 0; // bit n: a packet of channel n is waiting
+	uint32_t i = 0;
+
+	if ( n > USB_MIDI_NOTE_LANE_WINDOW )
+	{
+		n = USB_MIDI_NOTE_LANE_WINDOW;
+	}
+
+	for ( i = 0; ( i < n ) && ( blocked_ch != MIDI_CH_MASK_ALL ); i++ )
+	{
+		idx = (tail + i) & (USB_MIDI_EVENT_QUEUE_SIZE-1);
+		event = midi_event_queue.event[idx];
+		if ( event == USB_MIDI_EVENT_HOLE )
+		{
+			continue;
+		}
+		if ( ( event & 0x0F ) < USB_MIDI_CIN_NOTE_OFF || ( event & 0x0F ) > USB_MIDI_CIN_PITCH_BEND )
+		{// system messages
+			break;
+		}
+		ch_bit = 1U << ( (event >> 8) & 0x0F );
+		if ( ( get_event_lane(event) == USB_MIDI_LANE_NOTE ) && !( blocked_ch & ch_bit ) )
+		{
+			play_queued_event(idx, event);
+			midi_event_queue.event[idx] = USB_MIDI_EVENT_HOLE;
+			midi_note_lane_count++;
+		}
+		else
+		{
+			blocked_ch |= ch_bit;
+		}
+	}
+}
+
 static void init_midi_handle_list(void)
 {
 	uint32_t i = 0;
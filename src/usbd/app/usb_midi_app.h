@@ -31,13 +31,30 @@ typedef enum
 {
   YMF825_SOUND_DRIVER_MODE4 = 0,
   YMF825_SOUND_DRIVER_MUSIC_BOX,
+  YMF825_SOUND_DRIVER_POLY,
   NUM_OF_YMF825_SOUND_DRIVER
 } ymf825_sound_driver_t;
 
+// packets dropped because a later packet in the queue set the same value
+typedef struct
+{
+	uint32_t cc_count;
+	uint32_t pitch_bend_count;
+	uint32_t pressure_count;	// channel and polyphonic key pressure
+} usb_midi_coalesce_stat_t;
+
 
 extern void    init_usb_midi_app(void);
 extern int32_t usb_midi_proc(const uint8_t *mid_msg,  size_t len);
+extern int32_t usb_midi_receive_irq(const uint8_t *mid_msg,  size_t len);
+extern void    usb_midi_task(void);
+extern uint32_t get_usb_midi_event_queue_overflow_count(void);
+extern void    get_usb_midi_coalesce_stat(usb_midi_coalesce_stat_t *stat);
+extern uint32_t get_usb_midi_note_lane_count(void);
 extern int32_t switch_ymf825_sound_driver(ymf825_sound_driver_t driver);
 extern ymf825_sound_driver_t get_selected_ymf825_sound_driver(void);
+extern void    update_usb_midi_sink_mask(void);
+extern void    set_usb_midi_filter(uint16_t ch_mask, uint8_t msg_mask);
+extern void    get_usb_midi_filter(uint16_t *ch_mask, uint8_t *msg_mask);
 
 #endif//__USB_MIDI_H__
@@ -34,6 +34,9 @@ OF SUCH DAMAGE.
 #include <usbd_enum.h>
 #include "midi_cdc_desc.h"
 #include "midi_cdc_core.h"
+#ifdef USE_LATENCY_STAT
+#include "latency_stat.h"
+#endif
 
 
 // usb cdc acm data send buffer page
@@ -44,6 +47,11 @@ OF SUCH DAMAGE.
 #define USB_CDC_TX_BUF_SIZE                     (CDC_ACM_DATA_PACKET_SIZE * 10)
 #endif
 
+// number of receive buffers for each out endpoint (MIDI, CDC)
+#ifndef USB_RX_BUF_NUM
+#define USB_RX_BUF_NUM                          2
+#endif
+
 #define SEND_ENCAPSULATED_COMMAND               0x00
 #define GET_ENCAPSULATED_RESPONSE               0x01
 #define SET_COMM_FEATURE                        0x02
@@ -63,6 +71,27 @@ typedef enum
    USB_CDC_SEND_STATUS_FINISHED
 }usb_cdc_send_status_t;
 
+typedef int32_t (*pf_usb_receive_callback_t)(const uint8_t *recv_data, size_t len);
+
+// receive control of an out endpoint (multiple buffering)
+typedef struct
+{
+    uint8_t   ep_addr;              // out endpoint address
+    uint8_t   fill_idx;             // buffer which is armed (or to be armed next)
+    uint8_t   read_idx;             // oldest received buffer
+    uint8_t   n_received;           // number of received buffers not yet accepted by the callback
+    uint8_t   armed;                // endpoint is armed to fill_idx
+    uint8_t   stalled;              // endpoint is left un-armed since every buffer is busy
+    uint16_t  buf_size;             // size of each receive buffer
+    uint8_t   *buf;                 // USB_RX_BUF_NUM * buf_size
+    uint32_t  len[USB_RX_BUF_NUM];  // received length of each buffer
+    uint32_t  busy_count;           // how often every buffer was busy on reception
+#ifdef USE_LATENCY_STAT
+    uint32_t  rx_stamp[USB_RX_BUF_NUM]; // mcycle at the reception of each buffer
+#endif
+    pf_usb_receive_callback_t callback;
+}usb_rx_ctrl_t;
+
 typedef struct
 {
     uint32_t dwDTERate;   /* data terminal rate */
@@ -89,14 +118,27 @@ static uint16_t current_end_position = 0;
 static uint8_t usb_cdc_tx_buffer[USB_CDC_TX_BUF_PAGE_NUM][USB_CDC_TX_BUF_SIZE];
 
 // usb cdc data receive buffer
-uint8_t usb_cdc_receive_buffer[CDC_ACM_DATA_PACKET_SIZE];
+uint8_t usb_cdc_receive_buffer[USB_RX_BUF_NUM][CDC_ACM_DATA_PACKET_SIZE];
 
 // usb midi receive buffer
-uint8_t usb_midi_receive_buffer[AUDIO_MS_PACKET_SIZE];
+uint8_t usb_midi_receive_buffer[USB_RX_BUF_NUM][AUDIO_MS_PACKET_SIZE];
 
-// receive callback functions
-static pf_usb_midi_receive_callback_t   usb_midi_recv_cb    = (pf_usb_midi_receive_callback_t)0;
-static pf_usb_cdc_receive_callback_t    usb_cdc_recv_cb     = (pf_usb_cdc_receive_callback_t)0;
+// receive control (including receive callback functions)
+static usb_rx_ctrl_t usb_cdc_rx = 
+{
+    .ep_addr    = CDC_OUT_EP,
+    .buf_size   = CDC_ACM_DATA_PACKET_SIZE,
+    .buf        = &usb_cdc_receive_buffer[0][0],
+    .callback   = (pf_usb_receive_callback_t)0
+};
+
+static usb_rx_ctrl_t usb_midi_rx = 
+{
+    .ep_addr    = MIDI_OUT_EP,
+    .buf_size   = AUDIO_MS_PACKET_SIZE,
+    .buf        = &usb_midi_receive_buffer[0][0],
+    .callback   = (pf_usb_receive_callback_t)0
+};
 
 
 static uint8_t  midi_cdc_init(usb_dev *udev, uint8_t config_index);
@@ -112,6 +154,11 @@ static uint8_t cdc_acm_EP0_RxReady (usb_dev *pudev);
 
 static void start_usb_cdc_send_service_irq(void);
 
+static void usb_rx_init(usb_dev *udev, usb_rx_ctrl_t *rx);
+static void usb_rx_received(usb_dev *udev, usb_rx_ctrl_t *rx);
+static void usb_rx_deliver(usb_dev *udev, usb_rx_ctrl_t *rx);
+static void usb_rx_arm(usb_dev *udev, usb_rx_ctrl_t *rx);
+
 
 static line_coding_struct linecoding =
 {
@@ -161,13 +208,36 @@ void init_usbd_midi_cdc(const pf_usb_cdc_receive_callback_t cdc_recv_cb, const p
 // register a callback function to be called when usb midi message received.
 void register_usb_midi_receive_callback(const pf_usb_midi_receive_callback_t callback)
 {
-    usb_midi_recv_cb = callback;
+    usb_midi_rx.callback = callback;
 }
 
 // register a callback function to be called when usb cdc data received.
 void register_usb_cdc_receive_callback(const pf_usb_cdc_receive_callback_t callback)
 {
-    usb_cdc_recv_cb = callback;
+    usb_cdc_rx.callback = callback;
+}
+
+// pass the received buffers which were not accepted by the callbacks yet.
+// called from the main loop.
+void usb_rx_service(void)
+{
+    if ( ( usb_midi_rx.n_received == 0 ) && ( usb_cdc_rx.n_received == 0 ) )
+    {
+        return;
+    }
+
+    // entry critical section
+    eclic_global_interrupt_disable();
+    usb_rx_deliver(&g_midi_cdc_udev, &usb_midi_rx);
+    usb_rx_deliver(&g_midi_cdc_udev, &usb_cdc_rx);
+    // leave critical section
+    eclic_global_interrupt_enable();
+}
+
+void get_usb_rx_stat(usb_rx_stat_t *out)
+{
+    out->midi_busy_count    = usb_midi_rx.busy_count;
+    out->cdc_busy_count     = usb_cdc_rx.busy_count;
 }
 
 int usb_cdc_printf(const char *format, ...)
@@ -233,8 +303,8 @@ static uint8_t  midi_cdc_init(usb_dev *udev, uint8_t config_index)
     midi_cdc_desc_ep_setup(udev);
 
     //  prepare receive data
-    usbd_ep_recev(udev, MIDI_OUT_EP, usb_midi_receive_buffer, AUDIO_MS_PACKET_SIZE);
-    usbd_ep_recev(udev, CDC_OUT_EP,  usb_cdc_receive_buffer,   CDC_ACM_DATA_PACKET_SIZE);
+    usb_rx_init(udev, &usb_midi_rx);
+    usb_rx_init(udev, &usb_cdc_rx);
 
     return 0;
 }
@@ -293,29 +363,17 @@ static uint8_t  midi_cdc_data_in(usb_dev *udev, uint8_t ep_num)
 
 static uint8_t  midi_cdc_data_out(usb_dev *udev, uint8_t ep_num)
 {
-    uint32_t  receive_length = 0U;
-
     if ((EP0_OUT & 0x7F) == ep_num) 
     {
         cdc_acm_EP0_RxReady (udev);
     } 
     else if ((CDC_OUT_EP & 0x7F) == ep_num) 
     {
-        receive_length = usbd_rxcount_get(udev, CDC_OUT_EP);
-        if ( usb_cdc_recv_cb )
-        {
-            usb_cdc_recv_cb(usb_cdc_receive_buffer, receive_length);
-        }
-        usbd_ep_recev(udev, CDC_OUT_EP, usb_cdc_receive_buffer, CDC_ACM_DATA_PACKET_SIZE);
+        usb_rx_received(udev, &usb_cdc_rx);
     }
     else if ((MIDI_OUT_EP & 0x7F) == ep_num)
     {
-        receive_length = usbd_rxcount_get(udev, MIDI_OUT_EP);
-        if ( usb_midi_recv_cb )
-        {
-            usb_midi_recv_cb(usb_midi_receive_buffer, receive_length);
-        }
-        usbd_ep_recev(udev, MIDI_OUT_EP, usb_midi_receive_buffer, AUDIO_MS_PACKET_SIZE);
+        usb_rx_received(udev, &usb_midi_rx);
     }
     else
     {
@@ -427,3 +485,83 @@ static void start_usb_cdc_send_service_irq(void)
     timer_enable(TIMER6);
 }
 
+static void usb_rx_init(usb_dev *udev, usb_rx_ctrl_t *rx)
+{
+    rx->fill_idx    = 0;
+    rx->read_idx    = 0;
+    rx->n_received  = 0;
+    rx->armed       = 0;
+    rx->stalled     = 0;
+    usb_rx_arm(udev, rx);
+}
+
+// called when the out endpoint received a packet.
+static void usb_rx_received(usb_dev *udev, usb_rx_ctrl_t *rx)
+{
+    rx->len[rx->fill_idx] = usbd_rxcount_get(udev, rx->ep_addr);
+#ifdef USE_LATENCY_STAT
+    rx->rx_stamp[rx->fill_idx] = LATENCY_STAT_NOW();
+#endif
+    rx->n_received++;
+    rx->armed = 0;
+    rx->fill_idx++;
+    if ( rx->fill_idx >= USB_RX_BUF_NUM )
+    {
+        rx->fill_idx = 0;
+    }
+
+    // re-arm the endpoint into a free buffer before the received one is processed.
+    usb_rx_arm(udev, rx);
+
+    usb_rx_deliver(udev, rx);
+}
+
+// pass the received buffers to the callback in order.
+// a buffer which the callback could not accept (returned non-zero) is held,
+// and passed again by usb_rx_service().
+static void usb_rx_deliver(usb_dev *udev, usb_rx_ctrl_t *rx)
+{
+    while ( rx->n_received > 0 )
+    {
+        if ( rx->callback )
+        {
+#ifdef USE_LATENCY_STAT
+            latency_stat_set_rx_stamp(rx->rx_stamp[rx->read_idx]);
+#endif
+            if ( rx->callback(&rx->buf[rx->read_idx * rx->buf_size], rx->len[rx->read_idx]) != 0 )
+            {// not accepted. try again later.
+                break;
+            }
+        }
+        rx->n_received--;
+        rx->read_idx++;
+        if ( rx->read_idx >= USB_RX_BUF_NUM )
+        {
+            rx->read_idx = 0;
+        }
+    }
+
+    usb_rx_arm(udev, rx);
+}
+
+// arm the out endpoint if there is a free buffer.
+// otherwise the host is NAKed until a buffer gets free.
+static void usb_rx_arm(usb_dev *udev, usb_rx_ctrl_t *rx)
+{
+    if ( rx->armed )
+    {
+        return;
+    }
+
+    if ( rx->n_received < USB_RX_BUF_NUM )
+    {
+        usbd_ep_recev(udev, rx->ep_addr, &rx->buf[rx->fill_idx * rx->buf_size], rx->buf_size);
+        rx->armed = 1;
+        rx->stalled = 0;
+    }
+    else if ( !rx->stalled )
+    {// every buffer is busy. counted once until the endpoint is armed again.
+        rx->stalled = 1;
+        rx->busy_count++;
+    }
+}
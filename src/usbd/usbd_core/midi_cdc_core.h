@@ -30,6 +30,12 @@
 typedef int32_t (*pf_usb_midi_receive_callback_t)(const uint8_t *recv_msg, size_t len); 
 typedef int32_t (*pf_usb_cdc_receive_callback_t)(const uint8_t *recv_data, size_t len);
 
+typedef struct
+{
+    uint32_t midi_busy_count; // how often every midi receive buffer was busy
+    uint32_t cdc_busy_count;  // how often every cdc receive buffer was busy
+} usb_rx_stat_t;
+
 extern void register_usb_midi_receive_callback(const pf_usb_midi_receive_callback_t callback);
 extern void register_usb_cdc_receive_callback(const pf_usb_cdc_receive_callback_t callback);
 
@@ -39,6 +45,9 @@ extern void init_usbd_midi_cdc(
 
 extern void usb_cdc_send_service_irq(void);
 
+extern void usb_rx_service(void);
+extern void get_usb_rx_stat(usb_rx_stat_t *out);
+
 extern int usb_cdc_printf(const char *format, ...);
 
 #endif/* MIDI_CDC_CORE_H */